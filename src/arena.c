@@ -0,0 +1,43 @@
+#include <stdlib.h>
+
+#include "arena.h"
+
+// Keeps every allocation aligned for any type, as malloc does
+#define CS430_ARENA_ALIGN 16
+
+int arenaInit(imageArena* arena, size_t capacity) {
+    if((arena->base = malloc(capacity)) == NULL) {
+        arena->capacity = 0;
+        arena->used = 0;
+        return -1;
+    }
+
+    arena->capacity = capacity;
+    arena->used = 0;
+
+    return 0;
+}
+
+void* arenaAlloc(imageArena* arena, size_t size) {
+    size_t start = (arena->used + CS430_ARENA_ALIGN - 1) &
+        ~(size_t)(CS430_ARENA_ALIGN - 1);
+
+    if(start > arena->capacity || size > arena->capacity - start) {
+        return NULL;
+    }
+
+    arena->used = start + size;
+
+    return arena->base + start;
+}
+
+void arenaReset(imageArena* arena) {
+    arena->used = 0;
+}
+
+void arenaFree(imageArena* arena) {
+    free(arena->base);
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
@@ -0,0 +1,21 @@
+#ifndef CS430_ARENA_H
+#define CS430_ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for many short-lived buffers that are all released at once,
+// such as the frames of one batch job.
+typedef struct imageArena {
+    unsigned char* base;
+    size_t capacity;
+    size_t used;
+} imageArena;
+
+int arenaInit(imageArena* arena, size_t capacity);
+// Returns NULL once the arena is exhausted; it never grows.
+void* arenaAlloc(imageArena* arena, size_t size);
+// Releases every allocation at once, keeping the backing memory.
+void arenaReset(imageArena* arena);
+void arenaFree(imageArena* arena);
+
+#endif // CS430_ARENA_H
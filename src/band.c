@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "band.h"
+#include "thread.h"
+#include "trace.h"
+#include "view.h"
+
+// Rows read between polls of a reader's cancel flag
+#define CS430_BAND_POLL_ROWS 16
+
+int bandReaderOpen(bandReader* reader, const char* path, size_t bandBytes,
+        readContext* ctx) {
+    size_t bandRows;
+
+    memset(reader, 0, sizeof(*reader));
+
+    // Binary mode so that P6 data is not mangled by newline translation
+    if((reader->fd = fopen(path, "rb")) == NULL) {
+        return readContextFail(ctx, READ_ERROR_IO, errno, "Cannot open input file");
+    }
+
+    if(readHeader(&reader->header, reader->fd, ctx) < 0) {
+        bandReaderClose(reader);
+        return -1;
+    }
+
+    bandRows = bandBytes / (sizeof(*reader->pixels) * reader->header.width);
+    if(bandBytes == 0 || bandRows > reader->header.height) {
+        bandRows = reader->header.height;
+    }
+    else if(bandRows == 0) {
+        bandRows = 1;
+    }
+    reader->bandRows = bandRows;
+
+    return 0;
+}
+
+int bandReaderNext(bandReader* reader, imageView* band, size_t* firstRow,
+        readContext* ctx) {
+    // Allocated on first use, as callers decoding into their own buffers
+    // have no need for it
+    if(reader->pixels == NULL && (reader->pixels = malloc(sizeof(*reader->pixels) *
+            reader->header.width * reader->bandRows)) == NULL) {
+        return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on band");
+    }
+
+    return bandReaderNextInto(reader, reader->pixels, band, firstRow, ctx);
+}
+
+int bandReaderNextInto(bandReader* reader, pixel* pixels, imageView* band,
+        size_t* firstRow, readContext* ctx) {
+    size_t rows = reader->header.height - reader->row;
+    double start;
+    int status;
+
+    if(rows == 0) {
+        return 0;
+    }
+    if(rows > reader->bandRows) {
+        rows = reader->bandRows;
+    }
+
+    *band = viewMake(pixels, reader->header.width, rows,
+        reader->header.width);
+    start = traceBegin();
+    status = 0;
+    for(size_t i = 0; status == 0 && i < rows; i += CS430_BAND_POLL_ROWS) {
+        size_t count = rows - i < CS430_BAND_POLL_ROWS ? rows - i :
+            CS430_BAND_POLL_ROWS;
+        imageView slice = viewMake(viewRow(band, i), band->width, count,
+            band->stride);
+
+        if(reader->cancel != NULL && atomicLoad(reader->cancel)) {
+            status = readContextFail(ctx, READ_ERROR_IO, ECANCELED,
+                "Read cancelled");
+        }
+        else {
+            status = readRows(&reader->header, reader->row + i, &slice,
+                reader->fd, ctx);
+        }
+    }
+    traceEnd("decodeBand", start);
+    if(status < 0) {
+        return -1;
+    }
+
+    *firstRow = reader->row;
+    reader->row += rows;
+
+    return 1;
+}
+
+void bandReaderClose(bandReader* reader) {
+    if(reader->fd != NULL) {
+        fclose(reader->fd);
+    }
+    free(reader->pixels);
+
+    reader->fd = NULL;
+    reader->pixels = NULL;
+}
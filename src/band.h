@@ -0,0 +1,39 @@
+#ifndef CS430_BAND_H
+#define CS430_BAND_H
+
+#include <stdio.h>
+
+#include "pnm.h"
+#include "read.h"
+
+// Decodes a file a band of rows at a time into one reused buffer, so only one
+// band of pixels is held at once however tall the image is.
+typedef struct bandReader {
+    FILE* fd;
+    pnmHeader header;
+    pixel* pixels;
+    size_t bandRows;
+    size_t row;
+    // If not NULL, polled while a band is read; once it is set the read stops
+    // and fails with ECANCELED. NULL after bandReaderOpen.
+    volatile long* cancel;
+} bandReader;
+
+// Opens path and reads its header; the image's size is then in
+// reader->header. Each band holds as many rows as fit in bandBytes of pixels,
+// but always at least one; 0 makes the whole image a single band.
+int bandReaderOpen(bandReader* reader, const char* path, size_t bandBytes,
+    readContext* ctx);
+// Decodes the next band into the reader's buffer and points band at it, with
+// firstRow set to the image row it starts at. Returns 1 for a band, 0 once
+// every row has been read, or -1 on error.
+int bandReaderNext(bandReader* reader, imageView* band, size_t* firstRow,
+    readContext* ctx);
+// As bandReaderNext, but decodes into pixels, which must hold bandRows rows
+// of the image's width. Readers only ever used this way never allocate a
+// buffer of their own.
+int bandReaderNextInto(bandReader* reader, pixel* pixels, imageView* band,
+    size_t* firstRow, readContext* ctx);
+void bandReaderClose(bandReader* reader);
+
+#endif // CS430_BAND_H
@@ -0,0 +1,55 @@
+#include <stdlib.h>
+
+#include "batch.h"
+
+typedef struct readJob {
+    const char* path;
+    readResult* result;
+} readJob;
+
+void readFileTask(void* arg);
+
+size_t readFiles(threadPool* pool, const char* const* paths, size_t count,
+        readResult* results) {
+    readJob* jobs;
+    poolGroup group;
+    size_t failures = 0;
+
+    if((jobs = malloc(sizeof(*jobs) * count)) == NULL) {
+        // Fall back to decoding on the calling thread
+        for(size_t i = 0; i < count; i++) {
+            readContextInit(&results[i].ctx);
+            results[i].status = imageLoad(&results[i].img, paths[i],
+                &results[i].ctx);
+            failures += results[i].status < 0;
+        }
+        return failures;
+    }
+
+    poolGroupInit(&group);
+    for(size_t i = 0; i < count; i++) {
+        jobs[i].path = paths[i];
+        jobs[i].result = &results[i];
+
+        if(poolSubmit(pool, &group, readFileTask, &jobs[i]) < 0) {
+            readFileTask(&jobs[i]);
+        }
+    }
+    poolWait(pool, &group);
+
+    for(size_t i = 0; i < count; i++) {
+        failures += results[i].status < 0;
+    }
+
+    free(jobs);
+
+    return failures;
+}
+
+void readFileTask(void* arg) {
+    readJob* job = arg;
+
+    readContextInit(&job->result->ctx);
+    job->result->status = imageLoad(&job->result->img, job->path,
+        &job->result->ctx);
+}
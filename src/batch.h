@@ -0,0 +1,21 @@
+#ifndef CS430_BATCH_H
+#define CS430_BATCH_H
+
+#include "image.h"
+#include "pool.h"
+#include "read.h"
+
+typedef struct readResult {
+    image img;
+    int status;
+    readContext ctx;
+} readResult;
+
+// Decodes every file concurrently on the pool, one task per file. Each result
+// holds its own status, error context and image (empty on failure), which the
+// caller releases with imageFree. Returns the number of files that failed to
+// decode.
+size_t readFiles(threadPool* pool, const char* const* paths, size_t count,
+    readResult* results);
+
+#endif // CS430_BATCH_H
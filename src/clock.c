@@ -0,0 +1,32 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#endif
+
+#include "clock.h"
+
+double clockSeconds(void) {
+#ifdef _WIN32
+    static double period = 0;
+    LARGE_INTEGER now;
+
+    // The frequency is fixed at boot, so it only needs asking once
+    if(period == 0) {
+        LARGE_INTEGER frequency;
+
+        QueryPerformanceFrequency(&frequency);
+        period = 1.0 / (double)frequency.QuadPart;
+    }
+
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * period;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
@@ -0,0 +1,8 @@
+#ifndef CS430_CLOCK_H
+#define CS430_CLOCK_H
+
+// Seconds on a monotonic clock with at least microsecond resolution. Only
+// differences between readings are meaningful.
+double clockSeconds(void);
+
+#endif // CS430_CLOCK_H
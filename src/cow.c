@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cow.h"
+#include "thread.h"
+#include "view.h"
+
+#define CS430_COW_TILE_PIXELS (CS430_COW_TILE_SIZE * CS430_COW_TILE_SIZE)
+
+cowTile* tileCreate(void);
+void tileRelease(cowTile* tile);
+imageView tileView(const cowImage* img, const cowTile* tile, size_t column, size_t row);
+
+int cowFromView(cowImage* img, const imageView* src) {
+    size_t count;
+
+    img->width = src->width;
+    img->height = src->height;
+    viewTileCount(src, CS430_COW_TILE_SIZE, CS430_COW_TILE_SIZE, &img->columns,
+        &img->rows);
+    count = img->columns * img->rows;
+
+    if((img->tiles = calloc(count, sizeof(*img->tiles))) == NULL) {
+        return -1;
+    }
+
+    for(size_t row = 0; row < img->rows; row++) {
+        for(size_t column = 0; column < img->columns; column++) {
+            cowTile* tile;
+            imageView from, to;
+
+            if((tile = tileCreate()) == NULL) {
+                cowFree(img);
+                return -1;
+            }
+            img->tiles[row * img->columns + column] = tile;
+
+            viewTile(src, CS430_COW_TILE_SIZE, CS430_COW_TILE_SIZE, column, row, &from);
+            to = tileView(img, tile, column, row);
+            viewCopy(&to, &from);
+        }
+    }
+
+    return 0;
+}
+
+int cowShare(cowImage* dst, const cowImage* src) {
+    size_t count = src->columns * src->rows;
+
+    *dst = *src;
+    if((dst->tiles = malloc(sizeof(*dst->tiles) * count)) == NULL) {
+        return -1;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        dst->tiles[i] = src->tiles[i];
+        atomicIncrement(&dst->tiles[i]->refs);
+    }
+
+    return 0;
+}
+
+void cowFree(cowImage* img) {
+    if(img->tiles != NULL) {
+        for(size_t i = 0; i < img->columns * img->rows; i++) {
+            if(img->tiles[i] != NULL) {
+                tileRelease(img->tiles[i]);
+            }
+        }
+        free(img->tiles);
+    }
+
+    memset(img, 0, sizeof(*img));
+}
+
+int cowTileView(const cowImage* img, size_t column, size_t row, imageView* view) {
+    if(column >= img->columns || row >= img->rows) {
+        return -1;
+    }
+
+    *view = tileView(img, img->tiles[row * img->columns + column], column, row);
+
+    return 0;
+}
+
+int cowTileViewWritable(cowImage* img, size_t column, size_t row, imageView* view) {
+    cowTile** slot;
+
+    if(column >= img->columns || row >= img->rows) {
+        return -1;
+    }
+
+    slot = &img->tiles[row * img->columns + column];
+
+    // A count of one means this image holds the only reference, and no one
+    // else can take a new one without going through this image.
+    if(atomicLoad(&(*slot)->refs) > 1) {
+        cowTile* copy;
+
+        if((copy = tileCreate()) == NULL) {
+            return -1;
+        }
+
+        memcpy(copy->pixels, (*slot)->pixels, sizeof(pixel) * CS430_COW_TILE_PIXELS);
+        tileRelease(*slot);
+        *slot = copy;
+    }
+
+    *view = tileView(img, *slot, column, row);
+
+    return 0;
+}
+
+int cowCopyToView(const cowImage* img, const imageView* dst) {
+    if(dst->width != img->width || dst->height != img->height) {
+        return -1;
+    }
+
+    for(size_t row = 0; row < img->rows; row++) {
+        for(size_t column = 0; column < img->columns; column++) {
+            imageView from, to;
+
+            cowTileView(img, column, row, &from);
+            viewTile(dst, CS430_COW_TILE_SIZE, CS430_COW_TILE_SIZE, column, row, &to);
+            viewCopy(&to, &from);
+        }
+    }
+
+    return 0;
+}
+
+size_t cowUniqueBytes(const cowImage* img) {
+    size_t unique = 0;
+
+    for(size_t i = 0; i < img->columns * img->rows; i++) {
+        if(atomicLoad(&img->tiles[i]->refs) == 1) {
+            unique += sizeof(pixel) * CS430_COW_TILE_PIXELS;
+        }
+    }
+
+    return unique;
+}
+
+cowTile* tileCreate(void) {
+    cowTile* tile;
+
+    // One allocation holds both the count and the pixels that follow it
+    if((tile = malloc(sizeof(*tile) + sizeof(pixel) * CS430_COW_TILE_PIXELS)) == NULL) {
+        return NULL;
+    }
+
+    tile->refs = 1;
+    tile->pixels = (pixel*)(tile + 1);
+
+    return tile;
+}
+
+void tileRelease(cowTile* tile) {
+    if(atomicDecrement(&tile->refs) == 0) {
+        free(tile);
+    }
+}
+
+imageView tileView(const cowImage* img, const cowTile* tile, size_t column, size_t row) {
+    size_t x = column * CS430_COW_TILE_SIZE;
+    size_t y = row * CS430_COW_TILE_SIZE;
+
+    return viewMake(tile->pixels,
+        img->width - x < CS430_COW_TILE_SIZE ? img->width - x : CS430_COW_TILE_SIZE,
+        img->height - y < CS430_COW_TILE_SIZE ? img->height - y : CS430_COW_TILE_SIZE,
+        CS430_COW_TILE_SIZE);
+}
@@ -0,0 +1,44 @@
+#ifndef CS430_COW_H
+#define CS430_COW_H
+
+#include <stddef.h>
+
+#include "pnm.h"
+
+#define CS430_COW_TILE_SIZE 256
+
+// A reference-counted tile of up to CS430_COW_TILE_SIZE square pixels. Edge
+// tiles are allocated full size and only partly used.
+typedef struct cowTile {
+    volatile long refs;
+    pixel* pixels;
+} cowTile;
+
+// An image stored as a grid of shared tiles. Snapshots made with cowShare
+// point at the same tiles, and a tile is only duplicated when one of the
+// images sharing it asks to write to it, so each edit costs only the tiles it
+// touches.
+typedef struct cowImage {
+    size_t width;
+    size_t height;
+    size_t columns;
+    size_t rows;
+    cowTile** tiles;
+} cowImage;
+
+int cowFromView(cowImage* img, const imageView* src);
+// Makes dst a snapshot of src that shares every tile.
+int cowShare(cowImage* dst, const cowImage* src);
+void cowFree(cowImage* img);
+
+// A read-only view of one tile, clipped to the image.
+int cowTileView(const cowImage* img, size_t column, size_t row, imageView* view);
+// Like cowTileView, but first gives this image a private copy of the tile if
+// any other image still shares it.
+int cowTileViewWritable(cowImage* img, size_t column, size_t row, imageView* view);
+// Flattens the tiles into a view of the full image size.
+int cowCopyToView(const cowImage* img, const imageView* dst);
+// Bytes of pixel data held by tiles that no other image shares.
+size_t cowUniqueBytes(const cowImage* img);
+
+#endif // CS430_COW_H
@@ -11,30 +11,59 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 #include <assert.h>
 
 #include <linmath.h>
-#include "read.h"
-
-typedef struct {
-    float Position[2];
-    float TexCoord[2];
-} Vertex;
-
-Vertex vertexes[] = {
-    {{1, -1}, {0.99999, 0.99999}}, // Bottom-right
-    {{1, 1},  {0.99999, 0}}, // Top-right
-    {{-1, -1}, {0, 0.99999}}, // Bottom-left
-    {{-1, 1}, {0, 0}}// Top-left
-};
+#include "clock.h"
+#include "headless.h"
+#include "batch.h"
+#include "image.h"
+#include "input.h"
+#include "loader.h"
+#include "pathlist.h"
+#include "pool.h"
+#include "pyramid.h"
+#include "scale.h"
+#include "slideshow.h"
+#include "stats.h"
+#include "texgrid.h"
+#include "texpool.h"
+#include "tilecache.h"
+#include "transform.h"
+#include "trace.h"
+#include "upload.h"
+#include "write.h"
 
 #define ANGLE_STEP 1.5707963267948966192313216916398
 #define TRANSLATE_STEP 0.2
 #define SCALE_STEP 2
 #define SHEAR_STEP 0.1
 
+#define WINDOW_WIDTH 1024
+#define WINDOW_HEIGHT 768
+// Bytes decoded per band while an image streams in; one is uploaded per frame
+#define BAND_BYTES (1 << 20)
+// Threads decoding a slideshow's neighbouring slides
+#define DECODE_THREADS 2
+// Seconds between refreshes of the frame figures in the title
+#define STATS_INTERVAL 0.5
+
 mat4x4 matrix;
 float angle;
+// Set whenever what is on screen is out of date; frames are only drawn then
+int dirty = 1;
+// Slides to move by in a slideshow, applied by the render loop
+long slide_step;
+// Where to write the trace on exit, if anywhere
+const char* trace_path;
+// Keys and resizes being recorded for --record, or NULL
+inputLog* recording;
+// clockSeconds() when recording or replaying began
+double input_origin;
+// Set during --replay, when Escape is the only key taken from the keyboard
+int replaying;
 
 static void matrix_reset() {
     mat4x4_identity(matrix);
@@ -54,8 +83,10 @@ static const char* vertex_shader_src =
 static const char* fragment_shader_src =
     "varying highp vec2 TexCoordOut;\n"
     "uniform sampler2D Texture;\n"
+    "uniform highp float Filled;\n"
     "void main()\n"
     "{\n"
+    "    if (TexCoordOut.y >= Filled) discard;\n"
     "    gl_FragColor = texture2D(Texture, TexCoordOut);\n"
     "}\n";
 
@@ -64,68 +95,408 @@ static void error_callback(int error, const char* description)
     fprintf(stderr, "Error: %s\n", description);
 }
 
-static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+// Applies the transform bound to key to the view, as a press in the window
+// would
+static void apply_key(int key)
 {
     mat4x4 transform_m;
     mat4x4_identity(transform_m);
 
-    // Exit
-    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
-        glfwSetWindowShouldClose(window, GLFW_TRUE);
-    }
     // Rotate left
-    if(key == GLFW_KEY_LEFT_BRACKET && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_LEFT_BRACKET) {
         mat4x4_rotate_Z(matrix, matrix, ANGLE_STEP);
     }
     // Rotate right
-    if(key == GLFW_KEY_RIGHT_BRACKET && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_RIGHT_BRACKET) {
         mat4x4_rotate_Z(matrix, matrix, -ANGLE_STEP);
     }
     // Shear parallel to x
-    if(key == GLFW_KEY_SEMICOLON && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_SEMICOLON) {
         transform_m[1][0] = -SHEAR_STEP;
     }
-    if(key == GLFW_KEY_APOSTROPHE && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_APOSTROPHE) {
         transform_m[1][0] = SHEAR_STEP;
     }
     // Shear parallel to y
-    if(key == GLFW_KEY_PERIOD && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_PERIOD) {
         transform_m[0][1] = -SHEAR_STEP;
     }
-    if(key == GLFW_KEY_SLASH && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_SLASH) {
         transform_m[0][1] = SHEAR_STEP;
     }
     // Zoom in
-    if(key == GLFW_KEY_EQUAL && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_EQUAL) {
         transform_m[0][0] = SCALE_STEP;
         transform_m[1][1] = SCALE_STEP;
     }
     // Zoom out
-    if(key == GLFW_KEY_MINUS && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_MINUS) {
         transform_m[0][0] = 1 / (float)SCALE_STEP;
         transform_m[1][1] = 1 / (float)SCALE_STEP;
     }
     // Translate image
-    if(key == GLFW_KEY_UP && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_UP) {
         mat4x4_translate(transform_m, 0, TRANSLATE_STEP, 0);
     }
-    if(key == GLFW_KEY_LEFT && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_LEFT) {
         mat4x4_translate(transform_m, -TRANSLATE_STEP, 0, 0);
     }
-    if(key == GLFW_KEY_DOWN && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_DOWN) {
         mat4x4_translate(transform_m, 0, -TRANSLATE_STEP, 0);
     }
-    if(key == GLFW_KEY_RIGHT && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_RIGHT) {
         mat4x4_translate(transform_m, TRANSLATE_STEP, 0, 0);
     }
     // Reset
-    if(key == GLFW_KEY_ENTER && action == GLFW_PRESS) {
+    if(key == GLFW_KEY_ENTER) {
         matrix_reset(matrix);
     }
 
     mat4x4_mul(matrix, matrix, transform_m);
 }
 
+// Adds a key press or resize to the recording, if there is one
+static void record_input(inputType type, int key, int width, int height)
+{
+    inputEvent event;
+
+    if (recording == NULL) {
+        return;
+    }
+
+    event.time = clockSeconds() - input_origin;
+    event.type = type;
+    event.key = key;
+    event.width = width;
+    event.height = height;
+    if (inputLogAdd(recording, &event) < 0) {
+        fprintf(stderr, "Error: Memory allocation error on input recording\n");
+    }
+}
+
+// Acts on a key press, from the keyboard or a replay
+static void press_key(GLFWwindow* window, int key)
+{
+    // Exit
+    if (key == GLFW_KEY_ESCAPE) {
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
+    // Next and previous slide, keeping the view as it is
+    if(key == GLFW_KEY_PAGE_DOWN || key == GLFW_KEY_SPACE) {
+        slide_step++;
+    }
+    if(key == GLFW_KEY_PAGE_UP || key == GLFW_KEY_BACKSPACE) {
+        slide_step--;
+    }
+
+    apply_key(key);
+    dirty = 1;
+}
+
+static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS || (replaying && key != GLFW_KEY_ESCAPE)) {
+        return;
+    }
+
+    record_input(INPUT_KEY, key, 0, 0);
+    press_key(window, key);
+}
+
+// Presses each key in keys, a list such as "] = = up" separated by spaces or
+// commas. Keys are named by the character on them, or as up, down, left,
+// right and enter. Returns -1 at the first key that is not known.
+static int apply_keys(const char* keys)
+{
+    static const struct {
+        const char* name;
+        int key;
+    } named[] = {
+        { "up", GLFW_KEY_UP }, { "down", GLFW_KEY_DOWN },
+        { "left", GLFW_KEY_LEFT }, { "right", GLFW_KEY_RIGHT },
+        { "enter", GLFW_KEY_ENTER }
+    };
+
+    keys += strspn(keys, " ,");
+    while (*keys != '\0') {
+        size_t length = strcspn(keys, " ,");
+        int key = -1;
+
+        // Printable keys' codes are the ASCII of their unshifted character
+        if (length == 1) {
+            key = toupper((unsigned char)*keys);
+        }
+        for (size_t i = 0; i < sizeof(named) / sizeof(*named); i++) {
+            if (strlen(named[i].name) == length &&
+                    strncmp(named[i].name, keys, length) == 0) {
+                key = named[i].key;
+            }
+        }
+        if (key < 0) {
+            return -1;
+        }
+
+        apply_key(key);
+        keys += length;
+        keys += strspn(keys, " ,");
+    }
+
+    return 0;
+}
+
+static void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+    dirty = 1;
+}
+
+// Only recorded; the framebuffer size callback redraws
+static void window_size_callback(GLFWwindow* window, int width, int height)
+{
+    record_input(INPUT_RESIZE, 0, width, height);
+}
+
+// Feeds in the replayed input that is due, at speed times the pace it was
+// recorded at, or one event per call at a speed of 0. Returns when the next
+// event is due, in seconds from input_origin, or -1 once all are in.
+static double replay_input(GLFWwindow* window, inputLog* log, double speed)
+{
+    double now = clockSeconds() - input_origin;
+
+    while (log->next < log->count) {
+        const inputEvent* event = &log->events[log->next];
+
+        if (speed > 0 && event->time / speed > now) {
+            return event->time / speed;
+        }
+
+        log->next++;
+        if (event->type == INPUT_KEY) {
+            press_key(window, event->key);
+        }
+        else {
+            glfwSetWindowSize(window, event->width, event->height);
+            dirty = 1;
+        }
+
+        if (speed <= 0) {
+            return log->next < log->count ? 0 : -1;
+        }
+    }
+
+    return -1;
+}
+
+// Reports the frame times over a whole replay, for comparing builds
+static void print_replay_stats(const frameStats* stats, size_t events)
+{
+    frameSummary summary;
+
+    if (frameStatsSummarize(stats, stats->count, &summary) < 0) {
+        return;
+    }
+
+    printf("Replayed %zu events in %.3f s: %zu frames, p50 %.2f ms, "
+        "p99 %.2f ms, %zu dropped\n", events, clockSeconds() - input_origin,
+        summary.frames, summary.p50 * 1000, summary.p99 * 1000, stats->dropped);
+}
+
+// The window was uncovered or otherwise lost its contents
+static void window_refresh_callback(GLFWwindow* window)
+{
+    dirty = 1;
+}
+
+// Runs on whichever thread finished a tile read, a slide decode or published
+// a loader event, to break the render loop out of glfwWaitEvents
+static void wake_render_loop(void* arg)
+{
+    glfwPostEmptyEvent();
+}
+
+// Clears a width x height frame and sets up the projection, returning the MVP
+// for the drawing that follows. The program stays in use for the life of the
+// window, so only the uniform changes here.
+static void begin_frame(int width, int height, GLint mvp_location, mat4x4 mvp)
+{
+    float ratio;
+    mat4x4 p;
+
+    ratio = width / (float) height;
+
+    glViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    mat4x4_ortho(p, -ratio, ratio, -1.f, 1.f, 1.f, -1.f);
+    mat4x4_mul(mvp, p, matrix);
+
+    glUniformMatrix4fv(mvp_location, 1, GL_FALSE, (const GLfloat*) mvp);
+}
+
+static void print_read_error(const readContext* ctx)
+{
+    fprintf(stderr, "Error: %s (offset %lld)\n", ctx->message, ctx->offset);
+}
+
+// Applies one event other than a band from the background loader to the
+// textures, counting the preview's rows in preview_rows. Returns 0 while more
+// are to come, 1 once the image is complete, or -1 on an error.
+static int apply_load_event(loaderEvent* event, textureGrid* preview_grid,
+    size_t* preview_rows, textureGrid* full_grid, threadPool* pool,
+    texturePool* texture_pool, uploadBudget* uploads)
+{
+    image preview;
+    imageView view;
+    double start;
+
+    switch (event->type) {
+    case LOADER_HEADER:
+        // Allocated up front; the rows are filled in as their bands decode
+        if (textureGridCreate(full_grid, event->header.width,
+                event->header.height, 0, pool, texture_pool) < 0) {
+            fprintf(stderr, "Error: Memory allocation error on textures\n");
+            return -1;
+        }
+        return 0;
+    case LOADER_PREVIEW:
+        imageInit(&preview);
+        imageMove(&preview, &event->preview);
+        view = imageGetView(&preview);
+
+        // Small enough to fit the window, so it goes up in one piece
+        start = clockSeconds();
+        if (textureGridCreate(preview_grid, preview.header.width,
+                preview.header.height, 0, pool, texture_pool) == 0 &&
+                textureGridUpload(preview_grid, &view, 0) == 0) {
+            *preview_rows = preview.header.height;
+        }
+        uploadBudgetCharge(uploads, start, sizeof(pixel) * preview.header.width *
+            preview.header.height);
+
+        // The textures hold their own copy now
+        imageFree(&preview);
+        return 0;
+    case LOADER_PREVIEW_BAND:
+        // A preview that could not be set up is simply left out
+        start = clockSeconds();
+        if (event->firstRow == 0 && textureGridCreate(preview_grid,
+                scaledSize(full_grid->width, event->factor),
+                scaledSize(full_grid->height, event->factor), 0, pool,
+                texture_pool) < 0) {
+            return 0;
+        }
+        if (preview_grid->textures != NULL && *preview_rows == event->firstRow &&
+                textureGridUpload(preview_grid, &event->band, event->firstRow) == 0) {
+            *preview_rows += event->band.height;
+        }
+        uploadBudgetCharge(uploads, start, sizeof(pixel) * event->band.width *
+            event->band.height);
+        return 0;
+    case LOADER_DONE:
+        textureGridFree(preview_grid);
+        *preview_rows = 0;
+        return 1;
+    default:
+        print_read_error(&event->ctx);
+        return -1;
+    }
+}
+
+// Uploads the rows of a loader band that are not in yet, a few at a time
+// until the budget runs out. filled_rows doubles as the position within the
+// band. Returns 1 once the whole band is in, 0 if the budget ran out first,
+// or -1 on an error.
+static int upload_band(loaderEvent* event, textureGrid* full_grid,
+    size_t* filled_rows, uploadBudget* uploads)
+{
+    size_t rows = uploadBandRows(event->band.width);
+
+    while (*filled_rows < event->firstRow + event->band.height) {
+        size_t offset = *filled_rows - event->firstRow;
+        size_t count = event->band.height - offset < rows ?
+            event->band.height - offset : rows;
+        imageView part = event->band;
+        double start;
+
+        if (!uploadBudgetAvailable(uploads)) {
+            return 0;
+        }
+
+        part.pixels += offset * part.stride;
+        part.height = count;
+
+        start = clockSeconds();
+        if (textureGridUpload(full_grid, &part, *filled_rows) < 0) {
+            readContextFail(&event->ctx, READ_ERROR_MEMORY, 0,
+                "Memory allocation error on mipmaps");
+            print_read_error(&event->ctx);
+            return -1;
+        }
+        uploadBudgetCharge(uploads, start, sizeof(pixel) * part.width * count);
+
+        *filled_rows += count;
+    }
+
+    return 1;
+}
+
+// Shows the rolling frame figures after the title. Setting the title is a
+// round trip to the window system, so it happens at most every
+// STATS_INTERVAL, and only once frames have been drawn since the last time.
+static void show_frame_stats(GLFWwindow* window, const char* title,
+    const frameStats* stats, double* shown_at, size_t* shown_count)
+{
+    frameSummary summary;
+    char text[512];
+    double now = clockSeconds();
+    int length;
+
+    if (stats->count == *shown_count || now - *shown_at < STATS_INTERVAL ||
+            frameStatsSummarize(stats, CS430_STATS_WINDOW, &summary) < 0) {
+        return;
+    }
+
+    length = snprintf(text, sizeof(text), "%s - p50 %.1f ms, p99 %.1f ms, "
+        "%zu dropped", title, summary.p50 * 1000, summary.p99 * 1000,
+        stats->dropped);
+    if (summary.uploadRate > 0 && length > 0 && (size_t)length < sizeof(text)) {
+        snprintf(text + length, sizeof(text) - length, ", upload %.0f MB/s",
+            summary.uploadRate / (1024 * 1024));
+    }
+    glfwSetWindowTitle(window, text);
+
+    *shown_at = now;
+    *shown_count = stats->count;
+}
+
+// Runs at exit, so the trace is written however ezview ends. Every other
+// thread has been joined by then.
+static void write_trace(void)
+{
+    if (traceWrite(trace_path) < 0) {
+        fprintf(stderr, "Error: Cannot write %s\n", trace_path);
+    }
+    traceStop();
+}
+
+static int build_pyramid(const char* input_path, const char* output_path)
+{
+    readContext ctx;
+    threadPool* pool = poolCreate(0);
+    int status;
+
+    readContextInit(&ctx);
+    status = pyramidBuild(input_path, output_path, CS430_PYRAMID_TILE_SIZE, pool,
+        &ctx);
+    poolDestroy(pool);
+
+    if (status < 0) {
+        print_read_error(&ctx);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
 void glCompileShaderOrDie(GLuint shader) {
     GLint compiled;
 
@@ -147,57 +518,503 @@ void glCompileShaderOrDie(GLuint shader) {
     }
 }
 
-int main(int argc, const char* argv[])
+// Compiles and links the program that draws texture grids, and leaves it in
+// use with the sampler on texture unit 0. Returns the MVP uniform's location.
+static GLint setup_program(textureGridProgram* grid_program)
 {
-    // Load PPM file
-    if(argc != 2) {
-        fprintf(stderr, "usage: ezview /path/to/inputFile\n");
-        return EXIT_FAILURE;
+    GLuint vertex_shader, fragment_shader, program;
+    GLint mvp_location, vpos_location;
+
+    // NOTE: OpenGL error checks have been omitted for brevity
+
+    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertex_shader, 1, &vertex_shader_src, NULL);
+    glCompileShaderOrDie(vertex_shader);
+
+    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment_shader, 1, &fragment_shader_src, NULL);
+    glCompileShaderOrDie(fragment_shader);
+
+    program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+    // more error checking! glLinkProgramOrDie!
+
+    mvp_location = glGetUniformLocation(program, "MVP");
+    assert(mvp_location != -1);
+
+    vpos_location = glGetAttribLocation(program, "vPos");
+    assert(vpos_location != -1);
+
+    GLint texcoord_location = glGetAttribLocation(program, "TexCoordIn");
+    assert(texcoord_location != -1);
+
+    GLint tex_location = glGetUniformLocation(program, "Texture");
+    assert(tex_location != -1);
+
+    GLint filled_location = glGetUniformLocation(program, "Filled");
+    assert(filled_location != -1);
+
+    // Each texture grid points these at its own vertex buffer when drawn
+    glEnableVertexAttribArray(vpos_location);
+    glEnableVertexAttribArray(texcoord_location);
+
+    grid_program->position = vpos_location;
+    grid_program->texCoord = texcoord_location;
+    grid_program->filled = filled_location;
+
+    // Rows of 3-byte pixels are not 4-byte aligned for most widths
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // Bound once; nothing else uses another program or texture unit
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(program);
+    glUniform1i(tex_location, 0);
+
+    return mvp_location;
+}
+
+// Reports a transform script that failed to parse at offset, naming the
+// command and its line
+static void print_transform_error(const char* source, const char* script,
+    size_t offset)
+{
+    size_t line = 1;
+
+    for (size_t i = 0; i < offset; i++) {
+        line += script[i] == '\n';
     }
 
-    const char* inputPath = argv[1];
+    fprintf(stderr, "Error: %s:%zu: Cannot parse \"%.*s\"\n", source, line,
+        (int)strcspn(script + offset, ";\n#"), script + offset);
+}
 
-    FILE* inputFd;
+// Starts the view from the identity, then presses keys and applies the
+// script file and the script, any of which may be NULL
+static int setup_view(const char* keys, const char* script_path,
+    const char* script)
+{
+    char* file_script;
+    size_t offset;
 
-    if((inputFd = fopen(inputPath, "r")) == NULL) {
-        perror("Error: Cannot open input file\n");
-        return EXIT_FAILURE;
+    matrix_reset();
+
+    if (keys != NULL && apply_keys(keys) < 0) {
+        fprintf(stderr, "Error: Unknown key in \"%s\"\n", keys);
+        return -1;
     }
 
-    pnmHeader header;
-    pixel* pixels;
+    if (script_path != NULL) {
+        if ((file_script = transformRead(script_path)) == NULL) {
+            fprintf(stderr, "Error: Cannot read %s\n", script_path);
+            return -1;
+        }
+        if (transformApply(matrix, file_script, &offset) < 0) {
+            print_transform_error(script_path, file_script, offset);
+            free(file_script);
+            return -1;
+        }
+        free(file_script);
+    }
 
-    // Read the file, get format
-    if(readHeader(&header, inputFd) < 0) {
-        return EXIT_FAILURE;
+    if (script != NULL && transformApply(matrix, script, &offset) < 0) {
+        print_transform_error("--transform", script, offset);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Adds each path to list, or for a directory, the images in it
+static int list_paths(pathList* list, const char* const* paths, int count)
+{
+    for (int i = 0; i < count; i++) {
+        int status = pathIsDirectory(paths[i]) ?
+            pathListDirectory(list, paths[i]) : pathListAdd(list, paths[i]);
+
+        if (status < 0) {
+            fprintf(stderr, "Error: Cannot list %s\n", paths[i]);
+            return -1;
+        }
+    }
+
+    if (list->count == 0) {
+        fprintf(stderr, "Error: No images to show\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+// A file decoding on the decode pool while the one before it renders
+typedef struct batch_load {
+    const char* path;
+    readResult result;
+} batch_load;
+
+static void batch_load_task(void* arg)
+{
+    batch_load* load = arg;
+    double start = traceBegin();
+
+    imageInit(&load->result.img);
+    readContextInit(&load->result.ctx);
+    load->result.status = imageLoad(&load->result.img, load->path,
+        &load->result.ctx);
+    traceEnd("decodeFile", start);
+}
+
+static void batch_load_start(threadPool* pool, poolGroup* group,
+    batch_load* load, const char* path)
+{
+    load->path = path;
+
+    if (pool == NULL || poolSubmit(pool, group, batch_load_task, load) < 0) {
+        batch_load_task(load);
     }
+}
+
+// Where a batch writes input_path's frame: its name, with the extension
+// changed to .ppm, inside directory
+static char* batch_output_path(const char* directory, const char* input_path)
+{
+    const char* name = input_path;
+    const char* extension;
+    size_t name_length;
+    char* path;
+
+    for (const char* c = input_path; *c != '\0'; c++) {
+        if (*c == '/' || *c == '\\') {
+            name = c + 1;
+        }
+    }
+    extension = strrchr(name, '.');
+    name_length = extension != NULL ? (size_t)(extension - name) : strlen(name);
+
+    if ((path = malloc(strlen(directory) + name_length + 6)) != NULL) {
+        sprintf(path, "%s/%.*s.ppm", directory, (int)name_length, name);
+    }
+
+    return path;
+}
+
+// Renders each input into a width x height offscreen frame with the current
+// view, as the window would show it, and writes the frame as a P6: to
+// output_path for a single file, or into output_path as a directory for a
+// batch. Files decode one ahead on their own thread while the one before
+// renders, and every file shares one context, program and texture pool.
+// Needs no window system. A file that fails is reported and skipped.
+static int render_headless(char* const* input_paths, size_t count,
+    const char* output_path, int batch, size_t width, size_t height)
+{
+    headlessContext headless;
+    textureGridProgram grid_program;
+    texturePool texture_pool;
+    batch_load loads[2];
+    poolGroup group;
+    GLint mvp_location;
+    threadPool* pool;
+    threadPool* decode_pool;
+    size_t failures = 0;
 
-    if(header.mode != 3 || header.mode != 6) {
-        fprintf(stderr, "Error: PPM file must be P3 or P6.\n");
+    if (headlessCreate(&headless, width, height) < 0) {
+        fprintf(stderr, "Error: Cannot create an offscreen context (EGL error "
+            "0x%x)\n", (unsigned int)headless.error);
         return EXIT_FAILURE;
     }
 
-    if((pixels = malloc(sizeof(*pixels) * header.width * header.height)) == NULL) {
-        perror("Error: Memory allocation error on pixels\n");
+    mvp_location = setup_program(&grid_program);
+    texturePoolInit(&texture_pool, CS430_TEXTURE_POOL_BUDGET);
+    pool = poolCreate(0);
+    // Apart from the mip pool for the same reason as a slideshow's
+    decode_pool = count > 1 ? poolCreate(1) : NULL;
+    poolGroupInit(&group);
+
+    batch_load_start(decode_pool, &group, &loads[0], input_paths[0]);
+
+    for (size_t i = 0; i < count; i++) {
+        batch_load* load = &loads[i % 2];
+        textureGrid grid;
+        image frame;
+        imageView view;
+        mat4x4 mvp;
+        char* path;
+        double start;
+
+        if (decode_pool != NULL) {
+            poolWait(decode_pool, &group);
+        }
+        if (i + 1 < count) {
+            batch_load_start(decode_pool, &group, &loads[(i + 1) % 2],
+                input_paths[i + 1]);
+        }
+
+        if (load->result.status < 0) {
+            fprintf(stderr, "Error: %s: %s (offset %lld)\n", load->path,
+                load->result.ctx.message, load->result.ctx.offset);
+            failures++;
+            continue;
+        }
+
+        start = traceBegin();
+        path = batch ? batch_output_path(output_path, load->path) :
+            (char*)output_path;
+        imageInit(&frame);
+        view = imageGetView(&load->result.img);
+
+        // Drawn exactly as the window would draw it, through the same grid
+        if (path == NULL || textureGridCreate(&grid, view.width, view.height, 0,
+                pool, &texture_pool) < 0) {
+            fprintf(stderr, "Error: Memory allocation error on textures\n");
+            failures++;
+        }
+        else {
+            if (textureGridUpload(&grid, &view, 0) < 0) {
+                fprintf(stderr, "Error: Memory allocation error on mipmaps\n");
+                failures++;
+            }
+            else {
+                begin_frame((int)width, (int)height, mvp_location, mvp);
+                textureGridDraw(&grid, &grid_program, mvp, view.height);
+
+                if (headlessRead(&headless, &frame) < 0) {
+                    fprintf(stderr, "Error: Cannot read back the frame\n");
+                    failures++;
+                }
+                else if (strcmp(path, load->path) == 0) {
+                    fprintf(stderr, "Error: Not overwriting %s\n", path);
+                    failures++;
+                }
+                else {
+                    view = imageGetView(&frame);
+                    if (writeViewFile(&view, path) < 0) {
+                        fprintf(stderr, "Error: Cannot write %s\n", path);
+                        failures++;
+                    }
+                }
+            }
+            // Its textures go back to the pool for the next file to refill
+            textureGridFree(&grid);
+        }
+
+        if (batch) {
+            free(path);
+        }
+        imageFree(&frame);
+        imageFree(&load->result.img);
+        traceEnd("renderFile", start);
+    }
+
+    poolDestroy(decode_pool);
+    poolDestroy(pool);
+    texturePoolFree(&texture_pool);
+    headlessDestroy(&headless);
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, const char* argv[])
+{
+    // Milliseconds of texture uploads allowed per frame
+    double upload_ms = CS430_UPLOAD_BUDGET_MS;
+    // Where to write the frame timings on exit, if anywhere
+    const char* stats_path = NULL;
+    // Set to render one frame offscreen to a file instead of opening a window
+    const char* output_path = NULL;
+    const char* keys = NULL;
+    // Transforms for the initial view, from a script file and the command line
+    const char* transform_path = NULL;
+    const char* transform = NULL;
+    unsigned int output_width = WINDOW_WIDTH, output_height = WINDOW_HEIGHT;
+    // Where to record keys and resizes to, or replay them from
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    // Multiple of the recorded pace to replay at; 0 replays an event a frame
+    double replay_speed = 1;
+    int first_path = 1;
+
+    while(first_path + 1 < argc && strncmp(argv[first_path], "--", 2) == 0) {
+        if(strcmp(argv[first_path], "--upload-ms") == 0) {
+            upload_ms = atof(argv[first_path + 1]);
+        }
+        else if(strcmp(argv[first_path], "--stats") == 0) {
+            stats_path = argv[first_path + 1];
+        }
+        else if(strcmp(argv[first_path], "--trace") == 0) {
+            trace_path = argv[first_path + 1];
+        }
+        else if(strcmp(argv[first_path], "--output") == 0) {
+            output_path = argv[first_path + 1];
+        }
+        else if(strcmp(argv[first_path], "--keys") == 0) {
+            keys = argv[first_path + 1];
+        }
+        else if(strcmp(argv[first_path], "--transform") == 0) {
+            transform = argv[first_path + 1];
+        }
+        else if(strcmp(argv[first_path], "--transform-file") == 0) {
+            transform_path = argv[first_path + 1];
+        }
+        else if(strcmp(argv[first_path], "--record") == 0) {
+            record_path = argv[first_path + 1];
+        }
+        else if(strcmp(argv[first_path], "--replay") == 0) {
+            replay_path = argv[first_path + 1];
+        }
+        else if(strcmp(argv[first_path], "--replay-speed") == 0) {
+            replay_speed = atof(argv[first_path + 1]);
+            if(replay_speed < 0) {
+                first_path = argc;
+                break;
+            }
+        }
+        else if(strcmp(argv[first_path], "--size") == 0) {
+            if(sscanf(argv[first_path + 1], "%ux%u", &output_width,
+                    &output_height) != 2 || output_width == 0 || output_height == 0) {
+                first_path = argc;
+                break;
+            }
+        }
+        else if(strcmp(argv[first_path], "--pyramid") == 0) {
+            break;
+        }
+        else {
+            first_path = argc;
+            break;
+        }
+        first_path += 2;
+    }
+
+    // Load PPM file
+    if(argc <= first_path || (record_path != NULL && replay_path != NULL)) {
+        fprintf(stderr, "usage: ezview [options] /path/to/inputFile\n"
+            "       ezview [options] /path/to/inputFile... or /path/to/directory\n"
+            "       ezview [--trace file.json] --pyramid /path/to/inputFile /path/to/outputFile\n"
+            "options: --upload-ms N      milliseconds of uploads per frame\n"
+            "         --stats file.json  write frame timings on exit\n"
+            "         --trace file.json  write a trace of decodes, uploads and frames\n"
+            "                            on exit, for chrome://tracing or Perfetto\n"
+            "         --output file.ppm  render offscreen to file.ppm, without a window;\n"
+            "                            a directory for several files or a directory\n"
+            "         --size WxH         size of the offscreen render, 1024x768 by default\n"
+            "         --keys \"] = up\"   key presses that set up the initial view\n"
+            "         --transform \"rotate 90; scale 2\"\n"
+            "                            transforms applied after the keys\n"
+            "         --transform-file file\n"
+            "                            the same, read from a script file\n"
+            "         --record file      record key presses and resizes to file\n"
+            "         --replay file      replay a recording, then exit\n"
+            "         --replay-speed N   multiple of the recorded pace, 1 by default;\n"
+            "                            0 replays one event a frame\n");
         return EXIT_FAILURE;
     }
-    if(readBody(header, pixels, inputFd) < 0) {
+
+    // Started before any thread, so that every thread's spans are caught
+    if (trace_path != NULL) {
+        if (traceStart() < 0) {
+            fprintf(stderr, "Error: Cannot start tracing\n");
+            return EXIT_FAILURE;
+        }
+        traceThreadName("render");
+        atexit(write_trace);
+    }
+
+    // Pre-pass for images too large to view directly
+    if(strcmp(argv[first_path], "--pyramid") == 0) {
+        if(argc != first_path + 3) {
+            fprintf(stderr, "usage: ezview [--trace file.json] --pyramid "
+                "/path/to/inputFile /path/to/outputFile\n");
+            return EXIT_FAILURE;
+        }
+        return build_pyramid(argv[first_path + 1], argv[first_path + 2]);
+    }
+
+    if (setup_view(keys, transform_path, transform) < 0) {
         return EXIT_FAILURE;
     }
 
-    if(fclose(inputFd) == EOF) {
-        perror("Error: Closing file\n");
+    // Batch rendering of several files, or a directory of them, goes into a
+    // directory
+    if (output_path != NULL) {
+        pathList inputs;
+        int batch = argc - first_path > 1 || pathIsDirectory(argv[first_path]) ||
+            pathIsDirectory(output_path);
+        int status;
+
+        pathListInit(&inputs);
+        if (list_paths(&inputs, argv + first_path, argc - first_path) < 0) {
+            pathListFree(&inputs);
+            return EXIT_FAILURE;
+        }
+        if (batch && !pathIsDirectory(output_path)) {
+            fprintf(stderr, "Error: %s is not a directory\n", output_path);
+            pathListFree(&inputs);
+            return EXIT_FAILURE;
+        }
+
+        status = render_headless(inputs.paths, inputs.count, output_path, batch,
+            output_width, output_height);
+        pathListFree(&inputs);
+        return status;
+    }
+
+    const char* inputPath = argv[first_path];
+
+    readContext ctx;
+    pathList slide_paths;
+    inputLog input_log;
+    uploadBudget uploads;
+    frameStats stats;
+    // The image's path, or the current slide's
+    const char* title = inputPath;
+    // Several files, or a directory of them, are stepped through as slides
+    int slideshow_mode = argc - first_path > 1 || pathIsDirectory(inputPath);
+    // Pyramids from --pyramid are paged in by tile instead of streamed
+    int pyramid_mode = !slideshow_mode && pyramidProbe(inputPath);
+    int exit_status = EXIT_SUCCESS;
+
+    readContextInit(&ctx);
+    pathListInit(&slide_paths);
+    inputLogInit(&input_log);
+    uploadBudgetInit(&uploads, upload_ms);
+
+    if (replay_path != NULL) {
+        size_t error_line;
+
+        if (inputLogRead(&input_log, replay_path, &error_line) < 0) {
+            if (error_line > 0) {
+                fprintf(stderr, "Error: %s:%zu: Not an input event in order\n",
+                    replay_path, error_line);
+            }
+            else {
+                fprintf(stderr, "Error: Cannot read %s\n", replay_path);
+            }
+            inputLogFree(&input_log);
+            return EXIT_FAILURE;
+        }
+        replaying = 1;
+    }
+    if (record_path != NULL) {
+        recording = &input_log;
+    }
+
+    if (slideshow_mode &&
+            list_paths(&slide_paths, argv + first_path, argc - first_path) < 0) {
+        inputLogFree(&input_log);
+        pathListFree(&slide_paths);
         return EXIT_FAILURE;
     }
 
     // OpenGL Start
     GLFWwindow* window;
-    GLuint vertex_buffer, vertex_shader, fragment_shader, program;
-    GLint mvp_location, vpos_location, vcol_location;
+    textureGridProgram grid_program;
 
     glfwSetErrorCallback(error_callback);
 
     if (!glfwInit()) {
+        pathListFree(&slide_paths);
+        inputLogFree(&input_log);
         return EXIT_FAILURE;
     }
 
@@ -207,107 +1024,335 @@ int main(int argc, const char* argv[])
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
 
-    window = glfwCreateWindow(1024, 768, "Simple example", NULL, NULL);
+    window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, inputPath, NULL, NULL);
     if (!window) {
+        pathListFree(&slide_paths);
+        inputLogFree(&input_log);
         glfwTerminate();
         fprintf(stderr, "Error: glfwCreateWindow\n");
         return EXIT_FAILURE;
     }
 
+    // Frames spaced further apart than this missed a refresh
+    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = monitor != NULL ? glfwGetVideoMode(monitor) : NULL;
+
+    // A replay summarizes every frame when it ends
+    if (frameStatsInit(&stats, mode != NULL && mode->refreshRate > 0 ?
+            1.0 / mode->refreshRate : 1.0 / 60,
+            stats_path != NULL || replaying) < 0) {
+        fprintf(stderr, "Error: Memory allocation error on frame stats\n");
+        pathListFree(&slide_paths);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        inputLogFree(&input_log);
+        return EXIT_FAILURE;
+    }
+
     glfwSetKeyCallback(window, key_callback);
+    glfwSetWindowSizeCallback(window, window_size_callback);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
 
     glfwMakeContextCurrent(window);
     // gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
     glfwSwapInterval(1);
 
-    // NOTE: OpenGL error checks have been omitted for brevity
+    GLint mvp_location = setup_program(&grid_program);
 
-    glGenBuffers(1, &vertex_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertexes), vertexes, GL_STATIC_DRAW);
+    // Images can be larger than GL_MAX_TEXTURE_SIZE, so both are held as
+    // grids of textures the GPU can take
+    textureGrid preview_grid, full_grid;
+    tileCache cache;
+    backgroundLoader loader;
+    slideshow show;
+    // Textures of released slides, evicted tiles and the finished preview,
+    // kept to be refilled by the next of the same size
+    texturePool texture_pool;
 
-    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_src, NULL);
-    glCompileShaderOrDie(vertex_shader);
+    // Builds mip levels for the tiles a band touches, or reads pyramid tiles,
+    // in parallel. Without one that work happens on this thread.
+    threadPool* pool = poolCreate(0);
+    // Kept apart from the pool above, which this thread helps out while it
+    // waits on mip levels, so that it never ends up running a whole decode
+    threadPool* decode_pool = slideshow_mode ? poolCreate(DECODE_THREADS) : NULL;
 
-    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_src, NULL);
-    glCompileShaderOrDie(fragment_shader);
+    memset(&preview_grid, 0, sizeof(preview_grid));
+    memset(&full_grid, 0, sizeof(full_grid));
+    memset(&cache, 0, sizeof(cache));
+    memset(&loader, 0, sizeof(loader));
+    memset(&show, 0, sizeof(show));
+    texturePoolInit(&texture_pool, CS430_TEXTURE_POOL_BUDGET);
 
-    program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
-    // more error checking! glLinkProgramOrDie!
+    // Cleared if the view cannot be started in whichever mode it is in
+    int started = 1;
 
-    mvp_location = glGetUniformLocation(program, "MVP");
-    assert(mvp_location != -1);
+    if (slideshow_mode) {
+        if (slideshowOpen(&show, (const char* const*)slide_paths.paths,
+                slide_paths.count, CS430_SLIDESHOW_PREFETCH,
+                CS430_SLIDESHOW_BUDGET, decode_pool, pool, &texture_pool,
+                wake_render_loop, NULL) < 0) {
+            fprintf(stderr, "Error: Memory allocation error on slideshow\n");
+            started = 0;
+        }
+        else {
+            title = show.slides[show.current].path;
+            glfwSetWindowTitle(window, title);
+        }
+    }
+    else if (pyramid_mode) {
+        if (tileCacheOpen(&cache, inputPath, CS430_CACHE_BUDGET, pool,
+                &texture_pool, &ctx) < 0) {
+            print_read_error(&ctx);
+            started = 0;
+        }
+        else {
+            cache.notify = wake_render_loop;
+        }
+    }
+    // The window is already up, so the decode runs on its own thread and the
+    // loop shows a preview, then the full image, as they arrive. Only a few
+    // bands are ever held at once.
+    else if (loaderStart(&loader, inputPath, BAND_BYTES, WINDOW_WIDTH,
+            WINDOW_HEIGHT, wake_render_loop, NULL) < 0) {
+        fprintf(stderr, "Error: Cannot start loader thread\n");
+        started = 0;
+    }
 
-    vpos_location = glGetAttribLocation(program, "vPos");
-    assert(vpos_location != -1);
+    // A mode that fails to start releases its own state, leaving what all
+    // three share
+    if (!started) {
+        texturePoolFree(&texture_pool);
+        poolDestroy(decode_pool);
+        poolDestroy(pool);
+        pathListFree(&slide_paths);
+        inputLogFree(&input_log);
+        frameStatsFree(&stats);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
 
-    GLint texcoord_location = glGetAttribLocation(program, "TexCoordIn");
-    assert(texcoord_location != -1);
+    int loading = !pyramid_mode && !slideshow_mode;
+    size_t filled_rows = 0, preview_rows = 0;
+    // The loader started just before; close enough for the load's total
+    double load_start = clockSeconds(), load_upload = 0;
+    // End of the last frame's swap, and whether the next frame follows it
+    // straight away rather than after waiting for input
+    double last_swap = 0;
+    int back_to_back = 0;
+    double stats_shown_at = 0;
+    size_t stats_shown_count = 0;
+    // When the next replayed event is due, or -1 with none left
+    double replay_due = -1;
 
-    GLint tex_location = glGetUniformLocation(program, "Texture");
-    assert(tex_location != -1);
+    input_origin = clockSeconds();
 
-    glEnableVertexAttribArray(vpos_location);
-    glVertexAttribPointer(vpos_location,
-        2,
-        GL_FLOAT,
-        GL_FALSE,
-        sizeof(Vertex),
-        (void*) 0);
+    // Frames are drawn only when something changed. With nothing to decode
+    // or upload the loop sleeps in glfwWaitEvents until input, a resize or a
+    // finished tile read wakes it.
+    while (!glfwWindowShouldClose(window)) {
+        double frame_start = clockSeconds(), swap_start = 0, swap_end = 0;
+        int busy = 0;
 
-    glEnableVertexAttribArray(texcoord_location);
-    glVertexAttribPointer(texcoord_location,
-        2,
-        GL_FLOAT,
-        GL_FALSE,
-        sizeof(Vertex),
-        (void*) (sizeof(float) * 2));
-
-    GLuint texID;
-    glGenTextures(1, &texID);
-    glBindTexture(GL_TEXTURE_2D, texID);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, header.width, header.height, 0, GL_RGB,
-        GL_UNSIGNED_BYTE, pixels);
+        uploadBudgetReset(&uploads);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texID);
-    glUniform1i(tex_location, 0);
+        if (replaying) {
+            replay_due = replay_input(window, &input_log, replay_speed);
+        }
 
-    // Initialize matrix
-    matrix_reset(matrix);
+        if (slideshow_mode && slide_step != 0) {
+            slideshowStep(&show, slide_step);
+            slide_step = 0;
+            title = show.slides[show.current].path;
+            glfwSetWindowTitle(window, title);
+            stats_shown_at = 0;
+            dirty = 1;
+        }
 
-    while (!glfwWindowShouldClose(window)) {
-        float ratio;
-        int width, height;
-        mat4x4 p, mvp;
+        if (dirty) {
+            int width, height;
+            mat4x4 mvp;
+
+            double draw_start = traceBegin();
+
+            dirty = 0;
+            glfwGetFramebufferSize(window, &width, &height);
+            begin_frame(width, height, mvp_location, mvp);
+
+            if (slideshow_mode) {
+                size_t slide_rows;
+                const textureGrid* grid = slideshowCurrent(&show, &slide_rows);
+
+                // Nothing to show until a slide not prefetched has decoded
+                if (grid != NULL) {
+                    textureGridDraw(grid, &grid_program, mvp, slide_rows);
+                }
+            }
+            else if (pyramid_mode) {
+                tileCacheDraw(&cache, &grid_program, mvp_location, mvp, width,
+                    height, &uploads);
+            }
+            else {
+                // The preview, if any, shows under the rows not uploaded yet
+                if (preview_grid.textures != NULL) {
+                    textureGridDraw(&preview_grid, &grid_program, mvp,
+                        preview_rows);
+                }
+                if (full_grid.textures != NULL) {
+                    textureGridDraw(&full_grid, &grid_program, mvp, filled_rows);
+                }
+            }
+
+            traceEnd("draw", draw_start);
+
+            swap_start = clockSeconds();
+            glfwSwapBuffers(window);
+            swap_end = clockSeconds();
+            traceEnd("swap", swap_start);
+        }
 
-        glfwGetFramebufferSize(window, &width, &height);
-        ratio = width / (float) height;
+        if (loading) {
+            loaderEvent* event;
+            int status = 0, progressed = 0;
 
-        glViewport(0, 0, width, height);
-        glClear(GL_COLOR_BUFFER_BIT);
+            // Bands go up until the frame's upload time is spent, and one cut
+            // short stays queued to carry on from next frame
+            while (status == 0 && uploadBudgetAvailable(&uploads) &&
+                    (event = loaderPeek(&loader)) != NULL) {
+                progressed = 1;
 
-        mat4x4_ortho(p, -ratio, ratio, -1.f, 1.f, 1.f, -1.f);
-        mat4x4_mul(mvp, p, matrix);
+                if (event->type == LOADER_BAND) {
+                    int done = upload_band(event, &full_grid, &filled_rows,
+                        &uploads);
 
-        glUseProgram(program);
-        glUniformMatrix4fv(mvp_location, 1, GL_FALSE, (const GLfloat*) mvp);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                    if (done == 0) {
+                        break;
+                    }
+                    status = done < 0 ? -1 : 0;
+                }
+                else {
+                    status = apply_load_event(event, &preview_grid,
+                        &preview_rows, &full_grid, pool, &texture_pool, &uploads);
+                }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+                loaderRelease(&loader);
+            }
+
+            if (status != 0) {
+                // On an error, keep showing whatever rows made it in, unless
+                // there is nothing at all to show
+                if (status < 0 && full_grid.textures == NULL) {
+                    exit_status = EXIT_FAILURE;
+                    glfwSetWindowShouldClose(window, GLFW_TRUE);
+                }
+
+                // The loader's own times are gone once it stops
+                if (status > 0) {
+                    stats.load.open = loader.openSeconds;
+                    stats.load.preview = loader.previewSeconds;
+                    stats.load.decode = loader.decodeSeconds;
+                    stats.load.upload = load_upload + uploads.spent;
+                    stats.load.total = clockSeconds() - load_start;
+                    stats.loaded = 1;
+                }
+
+                loaderStop(&loader);
+                loading = 0;
+            }
+            load_upload += uploads.spent;
+
+            busy = progressed;
+        }
+        else if (slideshow_mode) {
+            const slide* failed;
+
+            // Uploads finished decodes within the budget, so keep going while
+            // there are more
+            busy = slideshowUpdate(&show, &uploads, &failed);
+            if (failed != NULL) {
+                fprintf(stderr, "Error: %s: %s (offset %lld)\n", failed->path,
+                    failed->ctx.message, failed->ctx.offset);
+            }
+        }
+        // Tiles are uploaded by the draw, as many as the budget allows
+        else if (pyramid_mode) {
+            busy = tileCacheHasUploads(&cache);
+        }
+
+        if (swap_end != 0 || uploads.bands > 0) {
+            frameSample sample;
+
+            sample.start = frame_start;
+            sample.swap = swap_end - swap_start;
+            sample.cpu = clockSeconds() - frame_start - sample.swap;
+            sample.interval = swap_end != 0 && back_to_back ?
+                swap_end - last_swap : 0;
+            sample.uploadSeconds = uploads.spent;
+            sample.uploadBytes = uploads.bytes;
+            frameStatsAdd(&stats, &sample);
+        }
+        if (swap_end != 0) {
+            last_swap = swap_end;
+        }
+        back_to_back = busy && swap_end != 0;
+
+        show_frame_stats(window, title, &stats, &stats_shown_at,
+            &stats_shown_count);
+        traceEnd("frame", frame_start);
+
+        // A replay ends once its last event has been drawn and nothing is
+        // left loading
+        if (replaying && replay_due < 0 && !busy && !dirty) {
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+        }
+
+        // Redraw straight away while loading makes progress; otherwise sleep
+        // until there is something new or the next replayed event is due
+        if (busy) {
+            glfwPollEvents();
+            dirty = 1;
+        }
+        else if (replay_due >= 0) {
+            double wait = replay_due - (clockSeconds() - input_origin);
+
+            if (wait > 0) {
+                glfwWaitEventsTimeout(wait);
+            }
+            else {
+                glfwPollEvents();
+            }
+        }
+        else {
+            glfwWaitEvents();
+        }
+    }
+
+    if (replaying) {
+        print_replay_stats(&stats, input_log.count);
+    }
+    if (record_path != NULL && inputLogWrite(&input_log, record_path) < 0) {
+        fprintf(stderr, "Error: Cannot write %s\n", record_path);
     }
 
+    if (stats_path != NULL && frameStatsWrite(&stats, stats_path) < 0) {
+        fprintf(stderr, "Error: Cannot write %s\n", stats_path);
+    }
+
+    loaderStop(&loader);
+    slideshowClose(&show);
+    tileCacheClose(&cache);
+    textureGridFree(&preview_grid);
+    textureGridFree(&full_grid);
+    texturePoolFree(&texture_pool);
+    poolDestroy(decode_pool);
+    poolDestroy(pool);
+    pathListFree(&slide_paths);
+    inputLogFree(&input_log);
+    frameStatsFree(&stats);
+
     glfwDestroyWindow(window);
     glfwTerminate();
     
-    return EXIT_SUCCESS;
+    return exit_status;
 }
@@ -0,0 +1,162 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "headless.h"
+
+// From EGL_MESA_platform_surfaceless, which the bundled headers predate
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+int headlessInitialize(headlessContext* headless);
+int headlessFail(headlessContext* headless);
+
+int headlessCreate(headlessContext* headless, size_t width, size_t height) {
+    static const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    static const EGLint contextAttributes[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+    EGLint surfaceAttributes[] = {
+        EGL_WIDTH, (EGLint)width,
+        EGL_HEIGHT, (EGLint)height,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount;
+
+    memset(headless, 0, sizeof(*headless));
+    headless->display = EGL_NO_DISPLAY;
+    headless->surface = EGL_NO_SURFACE;
+    headless->context = EGL_NO_CONTEXT;
+    headless->width = width;
+    headless->height = height;
+
+    if(headlessInitialize(headless) < 0) {
+        return -1;
+    }
+
+    if(!eglChooseConfig(headless->display, configAttributes, &config, 1,
+            &configCount) || configCount == 0 || !eglBindAPI(EGL_OPENGL_ES_API)) {
+        return headlessFail(headless);
+    }
+
+    if((headless->surface = eglCreatePbufferSurface(headless->display, config,
+            surfaceAttributes)) == EGL_NO_SURFACE ||
+            (headless->context = eglCreateContext(headless->display, config,
+            EGL_NO_CONTEXT, contextAttributes)) == EGL_NO_CONTEXT ||
+            !eglMakeCurrent(headless->display, headless->surface, headless->surface,
+            headless->context)) {
+        return headlessFail(headless);
+    }
+
+    return 0;
+}
+
+int headlessRead(headlessContext* headless, image* img) {
+    pnmHeader header = { 6, headless->width, headless->height, CS430_PNM_BYTE_MAX };
+    unsigned char* rgba;
+
+    // RGBA is the one format GLES2 always reads back
+    if((rgba = malloc(4 * headless->width * headless->height)) == NULL) {
+        return -1;
+    }
+    if(imageAllocate(img, &header) < 0) {
+        free(rgba);
+        return -1;
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, (GLsizei)headless->width, (GLsizei)headless->height,
+        GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+
+    // GL's first row is the bottom one
+    for(size_t y = 0; y < headless->height; y++) {
+        const unsigned char* in = rgba + 4 * headless->width *
+            (headless->height - 1 - y);
+        pixel* out = img->pixels + headless->width * y;
+
+        for(size_t x = 0; x < headless->width; x++) {
+            out[x].red = in[4 * x];
+            out[x].green = in[4 * x + 1];
+            out[x].blue = in[4 * x + 2];
+        }
+    }
+
+    free(rgba);
+    return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+void headlessDestroy(headlessContext* headless) {
+    if(headless->display == EGL_NO_DISPLAY) {
+        return;
+    }
+
+    eglMakeCurrent(headless->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+        EGL_NO_CONTEXT);
+    if(headless->context != EGL_NO_CONTEXT) {
+        eglDestroyContext(headless->display, headless->context);
+    }
+    if(headless->surface != EGL_NO_SURFACE) {
+        eglDestroySurface(headless->display, headless->surface);
+    }
+    eglTerminate(headless->display);
+
+    headless->display = EGL_NO_DISPLAY;
+    headless->surface = EGL_NO_SURFACE;
+    headless->context = EGL_NO_CONTEXT;
+}
+
+int headlessInitialize(headlessContext* headless) {
+    const char* extensions;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay;
+
+    headless->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if(headless->display != EGL_NO_DISPLAY &&
+            eglInitialize(headless->display, NULL, NULL)) {
+        return 0;
+    }
+    headless->display = EGL_NO_DISPLAY;
+
+    // Without a display server the default display fails, but Mesa can
+    // still render with no display at all
+    extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+        eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(extensions == NULL || strstr(extensions, "EGL_MESA_platform_surfaceless") == NULL ||
+            getPlatformDisplay == NULL) {
+        headless->error = eglGetError();
+        return -1;
+    }
+
+    headless->display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+        EGL_DEFAULT_DISPLAY, NULL);
+    if(headless->display == EGL_NO_DISPLAY ||
+            !eglInitialize(headless->display, NULL, NULL)) {
+        headless->display = EGL_NO_DISPLAY;
+        headless->error = eglGetError();
+        return -1;
+    }
+
+    return 0;
+}
+
+int headlessFail(headlessContext* headless) {
+    headless->error = eglGetError();
+    headlessDestroy(headless);
+
+    return -1;
+}
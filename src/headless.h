@@ -0,0 +1,33 @@
+#ifndef CS430_HEADLESS_H
+#define CS430_HEADLESS_H
+
+#include <EGL/egl.h>
+
+#include <stddef.h>
+
+#include "image.h"
+
+// An OpenGL ES 2 context that renders into an offscreen pbuffer, for use
+// where there is no window system. The default display is tried first, then
+// Mesa's surfaceless platform, which needs no display server at all and
+// renders on llvmpipe where there is no GPU.
+typedef struct headlessContext {
+    EGLDisplay display;
+    EGLSurface surface;
+    EGLContext context;
+    size_t width;
+    size_t height;
+    // The EGL error behind a failed headlessCreate
+    EGLint error;
+} headlessContext;
+
+// Creates the context with a width x height pbuffer and makes it current on
+// the calling thread.
+int headlessCreate(headlessContext* headless, size_t width, size_t height);
+// Waits for rendering to finish and reads the pbuffer into img, a new heap
+// image of the pbuffer's size, top row first.
+int headlessRead(headlessContext* headless, image* img);
+// Safe to call on a context that failed to create.
+void headlessDestroy(headlessContext* headless);
+
+#endif // CS430_HEADLESS_H
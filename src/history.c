@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "history.h"
+
+cowImage* historyState(editHistory* history, size_t index);
+int historyRestore(editHistory* history, size_t index, cowImage* img);
+
+int historyInit(editHistory* history, size_t capacity) {
+    memset(history, 0, sizeof(*history));
+
+    if(capacity == 0 ||
+            (history->states = calloc(capacity, sizeof(*history->states))) == NULL) {
+        return -1;
+    }
+
+    history->capacity = capacity;
+
+    return 0;
+}
+
+void historyFree(editHistory* history) {
+    for(size_t i = 0; i < history->count; i++) {
+        cowFree(historyState(history, i));
+    }
+
+    free(history->states);
+    memset(history, 0, sizeof(*history));
+}
+
+int historyPush(editHistory* history, const cowImage* img) {
+    cowImage snapshot;
+
+    if(cowShare(&snapshot, img) < 0) {
+        return -1;
+    }
+
+    // Drop the redo states past the current one
+    while(history->count > 0 && history->count - 1 > history->current) {
+        cowFree(historyState(history, --history->count));
+    }
+
+    // Drop the oldest state to make room
+    if(history->count == history->capacity) {
+        cowFree(historyState(history, 0));
+        history->start = (history->start + 1) % history->capacity;
+        history->count--;
+    }
+
+    *historyState(history, history->count) = snapshot;
+    history->current = history->count;
+    history->count++;
+
+    return 0;
+}
+
+int historyUndo(editHistory* history, cowImage* img) {
+    if(history->count == 0 || history->current == 0) {
+        return -1;
+    }
+
+    return historyRestore(history, history->current - 1, img);
+}
+
+int historyRedo(editHistory* history, cowImage* img) {
+    if(history->current + 1 >= history->count) {
+        return -1;
+    }
+
+    return historyRestore(history, history->current + 1, img);
+}
+
+cowImage* historyState(editHistory* history, size_t index) {
+    return &history->states[(history->start + index) % history->capacity];
+}
+
+int historyRestore(editHistory* history, size_t index, cowImage* img) {
+    cowImage snapshot;
+
+    if(cowShare(&snapshot, historyState(history, index)) < 0) {
+        return -1;
+    }
+
+    cowFree(img);
+    *img = snapshot;
+    history->current = index;
+
+    return 0;
+}
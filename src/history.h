@@ -0,0 +1,31 @@
+#ifndef CS430_HISTORY_H
+#define CS430_HISTORY_H
+
+#include <stddef.h>
+
+#include "cow.h"
+
+// Undo/redo over copy-on-write snapshots. Each entry shares every tile its
+// neighbours did not modify, so a long history of small edits costs only the
+// edited tiles.
+typedef struct editHistory {
+    cowImage* states;
+    size_t capacity;
+    size_t start;
+    size_t count;
+    // Index, relative to start, of the state the image was last set to
+    size_t current;
+} editHistory;
+
+// Keeps up to capacity states, i.e. capacity - 1 undo steps.
+int historyInit(editHistory* history, size_t capacity);
+void historyFree(editHistory* history);
+// Records a snapshot of img after an edit (or as the initial state). Any redo
+// states are dropped, as is the oldest state once the history is full.
+int historyPush(editHistory* history, const cowImage* img);
+// Replaces img with a snapshot of the previous or next state. Returns -1 when
+// there is nothing to undo or redo, leaving img untouched.
+int historyUndo(editHistory* history, cowImage* img);
+int historyRedo(editHistory* history, cowImage* img);
+
+#endif // CS430_HISTORY_H
@@ -0,0 +1,308 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "image.h"
+#include "region.h"
+#include "scale.h"
+
+int imageSizeFits(const pnmHeader* header);
+int imageLoadStream(image* img, const char* path, readContext* ctx);
+int imageLoadScaledFit(image* img, const char* path, size_t factor,
+    size_t maxWidth, size_t maxHeight, size_t* chosen, readContext* ctx);
+
+void imageInit(image* img) {
+    memset(img, 0, sizeof(*img));
+}
+
+int imageAllocate(image* img, const pnmHeader* header) {
+    imageInit(img);
+
+    if(!imageSizeFits(header)) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if((img->pixels = malloc(sizeof(*img->pixels) * header->width *
+            header->height)) == NULL) {
+        return -1;
+    }
+
+    img->header = *header;
+    img->storage = IMAGE_STORAGE_HEAP;
+
+    return 0;
+}
+
+int imageAllocateArena(image* img, const pnmHeader* header, imageArena* arena) {
+    imageInit(img);
+
+    if(!imageSizeFits(header)) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if((img->pixels = arenaAlloc(arena, sizeof(*img->pixels) * header->width *
+            header->height)) == NULL) {
+        return -1;
+    }
+
+    img->header = *header;
+    img->storage = IMAGE_STORAGE_ARENA;
+
+    return 0;
+}
+
+int imageLoad(image* img, const char* path, readContext* ctx) {
+    mappedFile map;
+    byteSpan span;
+    pnmHeader header;
+    imageView view;
+
+    imageInit(img);
+
+    if(mapFileOpen(&map, path) < 0) {
+        return imageLoadStream(img, path, ctx);
+    }
+
+    span.data = map.data;
+    span.length = map.length;
+    span.offset = 0;
+
+    if(readHeaderSpan(&header, &span, ctx) < 0) {
+        mapFileClose(&map);
+        return -1;
+    }
+
+    if(header.mode == 6 && header.maxColorSize <= CS430_PNM_BYTE_MAX) {
+        if(viewBodySpan(&header, &view, &span, ctx) < 0) {
+            mapFileClose(&map);
+            return -1;
+        }
+
+        // The mapping is copy-on-write, so handing out mutable pixels is safe
+        img->header = header;
+        img->pixels = view.pixels;
+        img->storage = IMAGE_STORAGE_MAPPED;
+        img->map = map;
+
+        return 0;
+    }
+
+    if(imageAllocate(img, &header) < 0) {
+        mapFileClose(&map);
+        return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on pixels");
+    }
+
+    view = imageGetView(img);
+    if(readBodySpan(&header, &view, &span, ctx) < 0) {
+        imageFree(img);
+        mapFileClose(&map);
+        return -1;
+    }
+
+    mapFileClose(&map);
+
+    return 0;
+}
+
+int imageLoadStream(image* img, const char* path, readContext* ctx) {
+    FILE* inputFd;
+    pnmHeader header;
+    imageView view;
+
+    // Binary mode so that P6 data is not mangled by newline translation
+    if((inputFd = fopen(path, "rb")) == NULL) {
+        return readContextFail(ctx, READ_ERROR_IO, errno, "Cannot open input file");
+    }
+
+    if(readHeader(&header, inputFd, ctx) < 0) {
+        fclose(inputFd);
+        return -1;
+    }
+
+    if(imageAllocate(img, &header) < 0) {
+        fclose(inputFd);
+        return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on pixels");
+    }
+
+    view = imageGetView(img);
+    if(readBody(&header, &view, inputFd, ctx) < 0) {
+        imageFree(img);
+        fclose(inputFd);
+        return -1;
+    }
+
+    if(fclose(inputFd) == EOF) {
+        imageFree(img);
+        return readContextFail(ctx, READ_ERROR_IO, errno, "Closing file");
+    }
+
+    return 0;
+}
+
+int imageLoadRegion(image* img, const char* path, size_t x, size_t y,
+        size_t width, size_t height, const rowIndex* index, readContext* ctx) {
+    FILE* inputFd;
+    pnmHeader header, regionHeader;
+    imageView view;
+    long long bodyOffset;
+
+    imageInit(img);
+
+    // Binary mode so that P6 data is not mangled by newline translation
+    if((inputFd = fopen(path, "rb")) == NULL) {
+        return readContextFail(ctx, READ_ERROR_IO, errno, "Cannot open input file");
+    }
+
+    if(readHeader(&header, inputFd, ctx) < 0) {
+        fclose(inputFd);
+        return -1;
+    }
+
+#ifdef _WIN32
+    bodyOffset = _ftelli64(inputFd);
+#else
+    bodyOffset = ftello(inputFd);
+#endif
+
+    regionHeader = header;
+    regionHeader.width = width;
+    regionHeader.height = height;
+
+    if(imageAllocate(img, &regionHeader) < 0) {
+        fclose(inputFd);
+        return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on pixels");
+    }
+
+    view = imageGetView(img);
+    if(readRegion(&header, bodyOffset, index, x, y, &view, inputFd, ctx) < 0) {
+        imageFree(img);
+        fclose(inputFd);
+        return -1;
+    }
+
+    fclose(inputFd);
+
+    return 0;
+}
+
+int imageLoadScaled(image* img, const char* path, size_t factor, readContext* ctx) {
+    return imageLoadScaledFit(img, path, factor, 0, 0, NULL, ctx);
+}
+
+int imageLoadFit(image* img, const char* path, size_t maxWidth, size_t maxHeight,
+        size_t* factor, readContext* ctx) {
+    return imageLoadScaledFit(img, path, 0, maxWidth, maxHeight, factor, ctx);
+}
+
+int imageLoadScaledFit(image* img, const char* path, size_t factor,
+        size_t maxWidth, size_t maxHeight, size_t* chosen, readContext* ctx) {
+    FILE* inputFd;
+    pnmHeader header, scaledHeader;
+    imageView view;
+
+    imageInit(img);
+
+    // Binary mode so that P6 data is not mangled by newline translation
+    if((inputFd = fopen(path, "rb")) == NULL) {
+        return readContextFail(ctx, READ_ERROR_IO, errno, "Cannot open input file");
+    }
+
+    if(readHeader(&header, inputFd, ctx) < 0) {
+        fclose(inputFd);
+        return -1;
+    }
+
+    // A factor of 0 means it is picked from the header to fit the bounds
+    if(factor == 0) {
+        factor = scaleFactorToFit(&header, maxWidth, maxHeight);
+    }
+    if(chosen != NULL) {
+        *chosen = factor;
+    }
+
+    scaledHeader = header;
+    scaledHeader.width = scaledSize(header.width, factor);
+    scaledHeader.height = scaledSize(header.height, factor);
+
+    if(imageAllocate(img, &scaledHeader) < 0) {
+        fclose(inputFd);
+        return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on pixels");
+    }
+
+    view = imageGetView(img);
+    if(readScaled(&header, factor, &view, inputFd, ctx) < 0) {
+        imageFree(img);
+        fclose(inputFd);
+        return -1;
+    }
+
+    fclose(inputFd);
+
+    return 0;
+}
+
+int imageClone(image* dst, const image* src) {
+    if(imageAllocate(dst, &src->header) < 0) {
+        return -1;
+    }
+
+    memcpy(dst->pixels, src->pixels, sizeof(*dst->pixels) * src->header.width *
+        src->header.height);
+
+    return 0;
+}
+
+void imageMove(image* dst, image* src) {
+    if(dst == src) {
+        return;
+    }
+
+    imageFree(dst);
+    *dst = *src;
+    imageInit(src);
+}
+
+void imageFree(image* img) {
+    switch(img->storage) {
+        case IMAGE_STORAGE_HEAP:
+            free(img->pixels);
+            break;
+        case IMAGE_STORAGE_MAPPED:
+            mapFileClose(&img->map);
+            break;
+        case IMAGE_STORAGE_ARENA:
+        case IMAGE_STORAGE_NONE:
+            break;
+    }
+
+    imageInit(img);
+}
+
+imageView imageGetView(image* img) {
+    imageView view;
+
+    view.pixels = img->pixels;
+    view.width = img->header.width;
+    view.height = img->header.height;
+    view.stride = img->header.width;
+
+    return view;
+}
+
+// Whether the header's pixel count can be sized in bytes without wrapping
+int imageSizeFits(const pnmHeader* header) {
+    return header->height == 0 ||
+        header->width <= SIZE_MAX / sizeof(pixel) / header->height;
+}
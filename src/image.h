@@ -0,0 +1,60 @@
+#ifndef CS430_IMAGE_H
+#define CS430_IMAGE_H
+
+#include <stddef.h>
+
+#include "pnm.h"
+#include "read.h"
+#include "arena.h"
+#include "mapfile.h"
+#include "rowindex.h"
+
+typedef enum imageStorage {
+    IMAGE_STORAGE_NONE = 0,
+    IMAGE_STORAGE_HEAP,
+    // Pixels point into a private mapping of the source file
+    IMAGE_STORAGE_MAPPED,
+    // Pixels belong to an arena and are released with it, not the image
+    IMAGE_STORAGE_ARENA
+} imageStorage;
+
+// An image that owns its pixel buffer along with the header it was read with.
+// Never copy one by assignment, as both copies would release the same buffer;
+// hand it on with imageMove, or duplicate it explicitly with imageClone.
+typedef struct image {
+    pnmHeader header;
+    pixel* pixels;
+    imageStorage storage;
+    mappedFile map;
+} image;
+
+void imageInit(image* img);
+int imageAllocate(image* img, const pnmHeader* header);
+int imageAllocateArena(image* img, const pnmHeader* header, imageArena* arena);
+// Loads a file, mapping it where possible: 8-bit P6 pixels are then used
+// straight from the mapping and every other format is decoded from it into
+// the heap. Files that cannot be mapped are read through stdio instead.
+int imageLoad(image* img, const char* path, readContext* ctx);
+// Loads only the width x height rectangle at (x, y); see readRegion. The
+// image's header carries the region's size. index may be NULL.
+int imageLoadRegion(image* img, const char* path, size_t x, size_t y,
+    size_t width, size_t height, const rowIndex* index, readContext* ctx);
+// Loads a preview reduced by factor with a box filter; see readScaled. The
+// image's header carries the reduced size.
+int imageLoadScaled(image* img, const char* path, size_t factor, readContext* ctx);
+// Loads a preview with the smallest power of two factor that fits within
+// maxWidth x maxHeight, storing the factor used. A factor of 1 means the
+// image is already at full resolution.
+int imageLoadFit(image* img, const char* path, size_t maxWidth, size_t maxHeight,
+    size_t* factor, readContext* ctx);
+// Deep copies src into a new heap image.
+int imageClone(image* dst, const image* src);
+// Transfers ownership of src's buffer to dst, releasing whatever dst held and
+// leaving src empty.
+void imageMove(image* dst, image* src);
+void imageFree(image* img);
+
+// The whole image as a view; crop it further with viewCrop or viewTile.
+imageView imageGetView(image* img);
+
+#endif // CS430_IMAGE_H
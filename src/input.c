@@ -0,0 +1,132 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "input.h"
+
+#define CS430_INPUT_LINE_MAX 256
+
+int inputLogParse(const char* line, inputEvent* event);
+
+void inputLogInit(inputLog* log) {
+    log->events = NULL;
+    log->count = 0;
+    log->capacity = 0;
+    log->next = 0;
+}
+
+int inputLogAdd(inputLog* log, const inputEvent* event) {
+    if(log->count == log->capacity) {
+        size_t capacity = log->capacity == 0 ? 64 : log->capacity * 2;
+        inputEvent* grown;
+
+        if((grown = realloc(log->events, sizeof(*grown) * capacity)) == NULL) {
+            return -1;
+        }
+        log->events = grown;
+        log->capacity = capacity;
+    }
+
+    log->events[log->count++] = *event;
+
+    return 0;
+}
+
+int inputLogWrite(const inputLog* log, const char* path) {
+    FILE* outputFd;
+
+    if((outputFd = fopen(path, "w")) == NULL) {
+        return -1;
+    }
+
+    for(size_t i = 0; i < log->count; i++) {
+        const inputEvent* event = &log->events[i];
+
+        if(event->type == INPUT_KEY) {
+            fprintf(outputFd, "%.6f key %d\n", event->time, event->key);
+        }
+        else {
+            fprintf(outputFd, "%.6f resize %d %d\n", event->time, event->width,
+                event->height);
+        }
+    }
+
+    if(ferror(outputFd)) {
+        fclose(outputFd);
+        return -1;
+    }
+
+    return fclose(outputFd) == 0 ? 0 : -1;
+}
+
+int inputLogRead(inputLog* log, const char* path, size_t* errorLine) {
+    FILE* inputFd;
+    char line[CS430_INPUT_LINE_MAX];
+    size_t lineNumber = 0;
+
+    *errorLine = 0;
+    if((inputFd = fopen(path, "r")) == NULL) {
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), inputFd) != NULL) {
+        inputEvent event;
+
+        lineNumber++;
+        // Blank lines are allowed, as from hand editing
+        if(line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+
+        if(inputLogParse(line, &event) < 0 ||
+                (log->count > 0 && event.time < log->events[log->count - 1].time)) {
+            *errorLine = lineNumber;
+            fclose(inputFd);
+            return -1;
+        }
+        if(inputLogAdd(log, &event) < 0) {
+            fclose(inputFd);
+            return -1;
+        }
+    }
+
+    if(ferror(inputFd)) {
+        fclose(inputFd);
+        return -1;
+    }
+
+    fclose(inputFd);
+    return 0;
+}
+
+void inputLogFree(inputLog* log) {
+    free(log->events);
+    inputLogInit(log);
+}
+
+int inputLogParse(const char* line, inputEvent* event) {
+    char type[16];
+    char extra;
+    int read;
+
+    memset(event, 0, sizeof(*event));
+    if(sscanf(line, "%lf %15s%n", &event->time, type, &read) != 2 ||
+            !isfinite(event->time) || event->time < 0) {
+        return -1;
+    }
+    line += read;
+
+    // %c catches anything left over after the arguments
+    if(strcmp(type, "key") == 0) {
+        event->type = INPUT_KEY;
+        return sscanf(line, "%d %c", &event->key, &extra) == 1 ? 0 : -1;
+    }
+    if(strcmp(type, "resize") == 0) {
+        event->type = INPUT_RESIZE;
+        return sscanf(line, "%d %d %c", &event->width, &event->height,
+            &extra) == 2 && event->width > 0 && event->height > 0 ? 0 : -1;
+    }
+
+    return -1;
+}
@@ -0,0 +1,47 @@
+#ifndef CS430_INPUT_H
+#define CS430_INPUT_H
+
+#include <stddef.h>
+
+typedef enum inputType {
+    INPUT_KEY,
+    INPUT_RESIZE
+} inputType;
+
+// A key press or window resize, timed in seconds from the start of the
+// recording
+typedef struct inputEvent {
+    double time;
+    inputType type;
+    // GLFW key code, for INPUT_KEY
+    int key;
+    // Window size in screen coordinates, for INPUT_RESIZE
+    int width;
+    int height;
+} inputEvent;
+
+// A recording of the input to the viewer, for replaying the same interaction
+// against different builds. Saved as text, one event per line:
+//
+//     0.512000 key 93
+//     1.250000 resize 800 600
+//
+// Events are kept in time order. next is how far a replay has got.
+typedef struct inputLog {
+    inputEvent* events;
+    size_t count;
+    size_t capacity;
+    size_t next;
+} inputLog;
+
+void inputLogInit(inputLog* log);
+// Appends a copy of event, which must not be earlier than the last.
+int inputLogAdd(inputLog* log, const inputEvent* event);
+int inputLogWrite(const inputLog* log, const char* path);
+// Reads a recording from path into an initialized, empty log. Returns -1 with
+// errorLine set to the first line that is not an event in order, or to 0 if
+// the file could not be read.
+int inputLogRead(inputLog* log, const char* path, size_t* errorLine);
+void inputLogFree(inputLog* log);
+
+#endif // CS430_INPUT_H
@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "loader.h"
+#include "scale.h"
+#include "trace.h"
+
+void loaderMain(void* arg);
+loaderEvent* loaderAcquire(backgroundLoader* loader);
+void loaderPublish(backgroundLoader* loader);
+void loaderFail(backgroundLoader* loader, const readContext* ctx);
+
+int loaderStart(backgroundLoader* loader, const char* path, size_t bandBytes,
+        size_t previewWidth, size_t previewHeight, loaderNotifyFn notify,
+        void* notifyArg) {
+    memset(loader, 0, sizeof(*loader));
+
+    loader->path = path;
+    loader->bandBytes = bandBytes;
+    loader->previewWidth = previewWidth;
+    loader->previewHeight = previewHeight;
+    loader->notify = notify;
+    loader->notifyArg = notifyArg;
+
+    if(mutexInit(&loader->lock) < 0) {
+        return -1;
+    }
+    if(conditionInit(&loader->space) < 0) {
+        mutexDestroy(&loader->lock);
+        return -1;
+    }
+
+    if(threadCreate(&loader->worker, loaderMain, loader) < 0) {
+        conditionDestroy(&loader->space);
+        mutexDestroy(&loader->lock);
+        return -1;
+    }
+    loader->running = 1;
+
+    return 0;
+}
+
+loaderEvent* loaderPeek(backgroundLoader* loader) {
+    long head = atomicLoad(&loader->head);
+
+    if(head == atomicLoad(&loader->tail)) {
+        return NULL;
+    }
+
+    return &loader->events[head % CS430_LOADER_SLOTS];
+}
+
+void loaderRelease(backgroundLoader* loader) {
+    atomicIncrement(&loader->head);
+
+    // The loader raises waiting before it checks for space, so if it missed
+    // this release it is guaranteed to be seen here
+    if(atomicLoad(&loader->waiting)) {
+        mutexLock(&loader->lock);
+        conditionSignal(&loader->space);
+        mutexUnlock(&loader->lock);
+    }
+}
+
+void loaderStop(backgroundLoader* loader) {
+    if(!loader->running) {
+        return;
+    }
+
+    atomicStore(&loader->cancelled, 1);
+    mutexLock(&loader->lock);
+    conditionBroadcast(&loader->space);
+    mutexUnlock(&loader->lock);
+    threadJoin(&loader->worker);
+
+    // Previews the consumer never took still belong to their events
+    while(loaderPeek(loader) != NULL) {
+        imageFree(&loaderPeek(loader)->preview);
+        atomicIncrement(&loader->head);
+    }
+
+    for(size_t i = 0; i < CS430_LOADER_SLOTS; i++) {
+        free(loader->bands[i]);
+    }
+    conditionDestroy(&loader->space);
+    mutexDestroy(&loader->lock);
+
+    memset(loader, 0, sizeof(*loader));
+}
+
+void loaderMain(void* arg) {
+    backgroundLoader* loader = arg;
+    bandReader reader;
+    loaderEvent* event;
+    readContext ctx;
+    scaleFilter filter;
+    size_t factor;
+    double start;
+
+    readContextInit(&ctx);
+    traceThreadName("loader");
+
+    start = clockSeconds();
+    if(bandReaderOpen(&reader, loader->path, loader->bandBytes, &ctx) < 0) {
+        loaderFail(loader, &ctx);
+        return;
+    }
+    loader->openSeconds = clockSeconds() - start;
+    reader.cancel = &loader->cancelled;
+
+    if((event = loaderAcquire(loader)) == NULL) {
+        bandReaderClose(&reader);
+        return;
+    }
+    event->type = LOADER_HEADER;
+    event->header = reader.header;
+    loaderPublish(loader);
+
+    // One band buffer per slot, so a band is never overwritten before the
+    // consumer releases it
+    for(size_t i = 0; i < CS430_LOADER_SLOTS; i++) {
+        if((loader->bands[i] = malloc(sizeof(*loader->bands[i]) *
+                reader.header.width * reader.bandRows)) == NULL) {
+            readContextFail(&ctx, READ_ERROR_MEMORY, 0,
+                "Memory allocation error on band");
+            loaderFail(loader, &ctx);
+            bandReaderClose(&reader);
+            return;
+        }
+    }
+
+    factor = scaleFactorToFit(&reader.header, loader->previewWidth,
+        loader->previewHeight);
+    memset(&filter, 0, sizeof(filter));
+
+    // Raw rows can be seeked to, so the preview samples a row in every factor
+    // before the full decode starts. ASCII rows cannot, so rather than parse
+    // the body twice, its preview is filtered from the bands as they go by.
+    if(factor > 1 && rawRowSize(&reader.header) != 0) {
+        image preview;
+        pnmHeader previewHeader = reader.header;
+        imageView view;
+
+        previewHeader.width = scaledSize(reader.header.width, factor);
+        previewHeader.height = scaledSize(reader.header.height, factor);
+
+        start = clockSeconds();
+        if(imageAllocate(&preview, &previewHeader) < 0) {
+            readContextFail(&ctx, READ_ERROR_MEMORY, 0,
+                "Memory allocation error on preview");
+            loaderFail(loader, &ctx);
+            bandReaderClose(&reader);
+            return;
+        }
+        view = imageGetView(&preview);
+        if(readSampled(&reader.header, factor, &view, reader.fd,
+                &loader->cancelled, &ctx) < 0) {
+            imageFree(&preview);
+            loaderFail(loader, &ctx);
+            bandReaderClose(&reader);
+            return;
+        }
+        loader->previewSeconds = clockSeconds() - start;
+        traceEnd("preview", start);
+
+        if((event = loaderAcquire(loader)) == NULL) {
+            imageFree(&preview);
+            bandReaderClose(&reader);
+            return;
+        }
+        event->type = LOADER_PREVIEW;
+        event->factor = factor;
+        imageMove(&event->preview, &preview);
+        loaderPublish(loader);
+    }
+    else if(factor > 1 && scaleFilterInit(&filter, &reader.header, factor) < 0) {
+        readContextFail(&ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on preview");
+        loaderFail(loader, &ctx);
+        bandReaderClose(&reader);
+        return;
+    }
+
+    while((event = loaderAcquire(loader)) != NULL) {
+        pixel* band = loader->bands[atomicLoad(&loader->tail) % CS430_LOADER_SLOTS];
+        imageView decoded;
+        int status;
+
+        // Timed apart from loaderAcquire, which may wait on the render thread
+        start = clockSeconds();
+        status = bandReaderNextInto(&reader, band, &event->band,
+            &event->firstRow, &ctx);
+        loader->decodeSeconds += clockSeconds() - start;
+        decoded = event->band;
+
+        // Nobody is left to take an event once loaderStop has cancelled
+        if(atomicLoad(&loader->cancelled)) {
+            break;
+        }
+
+        if(status > 0) {
+            event->type = LOADER_BAND;
+        }
+        else if(status == 0) {
+            event->type = LOADER_DONE;
+        }
+        else {
+            event->type = LOADER_ERROR;
+            event->ctx = ctx;
+        }
+        loaderPublish(loader);
+
+        if(status <= 0) {
+            break;
+        }
+
+        // The band stays intact until its slot comes round again, which is
+        // not before this event is published. Reduced rows are smaller than
+        // the band they come from, so they fit in the next slot's buffer.
+        if(filter.sums != NULL) {
+            size_t previewRows = filter.row / factor;
+
+            if((event = loaderAcquire(loader)) == NULL) {
+                break;
+            }
+            band = loader->bands[atomicLoad(&loader->tail) % CS430_LOADER_SLOTS];
+
+            start = clockSeconds();
+            event->band.height = scaleFilterPush(&filter, &decoded, band);
+            loader->previewSeconds += clockSeconds() - start;
+            traceEnd("preview", start);
+
+            // Otherwise the slot is simply acquired again for the next band
+            if(event->band.height > 0) {
+                event->type = LOADER_PREVIEW_BAND;
+                event->factor = factor;
+                event->firstRow = previewRows;
+                event->band.pixels = band;
+                event->band.width = scaledSize(reader.header.width, factor);
+                event->band.stride = event->band.width;
+                loaderPublish(loader);
+            }
+        }
+    }
+
+    scaleFilterFree(&filter);
+    bandReaderClose(&reader);
+}
+
+loaderEvent* loaderAcquire(backgroundLoader* loader) {
+    long tail = atomicLoad(&loader->tail);
+    loaderEvent* event;
+
+    if(tail - atomicLoad(&loader->head) == CS430_LOADER_SLOTS) {
+        mutexLock(&loader->lock);
+        atomicStore(&loader->waiting, 1);
+        while(tail - atomicLoad(&loader->head) == CS430_LOADER_SLOTS &&
+                !atomicLoad(&loader->cancelled)) {
+            conditionWait(&loader->space, &loader->lock);
+        }
+        atomicStore(&loader->waiting, 0);
+        mutexUnlock(&loader->lock);
+    }
+
+    if(atomicLoad(&loader->cancelled)) {
+        return NULL;
+    }
+
+    event = &loader->events[tail % CS430_LOADER_SLOTS];
+    memset(event, 0, sizeof(*event));
+    imageInit(&event->preview);
+    readContextInit(&event->ctx);
+
+    return event;
+}
+
+void loaderPublish(backgroundLoader* loader) {
+    atomicIncrement(&loader->tail);
+
+    if(loader->notify != NULL) {
+        loader->notify(loader->notifyArg);
+    }
+}
+
+void loaderFail(backgroundLoader* loader, const readContext* ctx) {
+    loaderEvent* event;
+
+    if((event = loaderAcquire(loader)) == NULL) {
+        return;
+    }
+
+    event->type = LOADER_ERROR;
+    event->ctx = *ctx;
+    loaderPublish(loader);
+}
@@ -0,0 +1,102 @@
+#ifndef CS430_LOADER_H
+#define CS430_LOADER_H
+
+#include <stddef.h>
+
+#include "band.h"
+#include "image.h"
+#include "pnm.h"
+#include "read.h"
+#include "thread.h"
+
+// Events in flight between the loader thread and the render thread. Each
+// holds one band, so this bounds the decoded pixels not yet uploaded.
+#define CS430_LOADER_SLOTS 4
+
+typedef enum loaderEventType {
+    // header holds the full image's size
+    LOADER_HEADER,
+    // preview holds an image reduced by factor to fit the preview size
+    LOADER_PREVIEW,
+    // band holds rows of the preview, reduced by factor, starting at
+    // firstRow. Sent as the full image's bands are decoded, when the preview
+    // cannot be sampled ahead of them.
+    LOADER_PREVIEW_BAND,
+    // band holds rows starting at firstRow
+    LOADER_BAND,
+    // Every row has been delivered
+    LOADER_DONE,
+    // ctx holds the error; no further events follow
+    LOADER_ERROR
+} loaderEventType;
+
+typedef struct loaderEvent {
+    loaderEventType type;
+    pnmHeader header;
+    // Owned by the receiver, which should take it with imageMove
+    image preview;
+    size_t factor;
+    // Points into a buffer the loader reuses once the event is released
+    imageView band;
+    size_t firstRow;
+    readContext ctx;
+} loaderEvent;
+
+typedef void (*loaderNotifyFn)(void* arg);
+
+// Decodes an image on its own thread: first the header, then the full image
+// a band at a time. An image larger than the preview size also gets a
+// reduced preview. For raw formats it is sampled up front from a fraction of
+// the rows. ASCII rows cannot be skipped, so their preview is box-filtered
+// from the bands as they are decoded instead of from a second pass. Results reach the consumer through a single-producer,
+// single-consumer ring that needs no lock. The loader only waits on a
+// condition when the ring is full.
+typedef struct backgroundLoader {
+    thread worker;
+    const char* path;
+    size_t bandBytes;
+    size_t previewWidth;
+    size_t previewHeight;
+    loaderNotifyFn notify;
+    void* notifyArg;
+
+    loaderEvent events[CS430_LOADER_SLOTS];
+    pixel* bands[CS430_LOADER_SLOTS];
+    // Counts of events published and released. Only the loader writes tail
+    // and only the consumer writes head.
+    volatile long tail;
+    volatile long head;
+    volatile long cancelled;
+    // Raised while the loader sleeps on a full ring
+    volatile long waiting;
+
+    // Seconds spent opening the file and reading its header, building the
+    // preview and decoding bands. Written by the loader before it publishes
+    // LOADER_DONE, so safe to read once that event is peeked.
+    double openSeconds;
+    double previewSeconds;
+    double decodeSeconds;
+
+    mutex lock;
+    condition space;
+    int running;
+} backgroundLoader;
+
+// Starts decoding path, which must stay valid until loaderStop. notify, if
+// not NULL, is called on the loader thread after every event is published,
+// so a consumer blocked waiting for input can wake.
+int loaderStart(backgroundLoader* loader, const char* path, size_t bandBytes,
+    size_t previewWidth, size_t previewHeight, loaderNotifyFn notify,
+    void* notifyArg);
+// The oldest unreleased event, or NULL if the loader has not published one
+// yet. Only one thread may consume.
+loaderEvent* loaderPeek(backgroundLoader* loader);
+// Hands the peeked event's slot back to the loader.
+void loaderRelease(backgroundLoader* loader);
+// Cancels any decode still running, waits for the thread and frees every
+// unreleased event. Safe to call on a loader that never started or has
+// already stopped. A preview or band being decoded is abandoned within a few
+// rows.
+void loaderStop(backgroundLoader* loader);
+
+#endif // CS430_LOADER_H
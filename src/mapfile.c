@@ -0,0 +1,98 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <errno.h>
+
+#include "mapfile.h"
+
+int mapFileOpen(mappedFile* map, const char* path) {
+#ifdef _WIN32
+    LARGE_INTEGER size;
+
+    map->data = NULL;
+    map->mapping = NULL;
+
+    if((map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL)) == INVALID_HANDLE_VALUE) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    if(!GetFileSizeEx(map->file, &size) || size.QuadPart == 0 ||
+            (unsigned long long)size.QuadPart > (size_t)-1) {
+        CloseHandle(map->file);
+        errno = EINVAL;
+        return -1;
+    }
+    map->length = (size_t)size.QuadPart;
+
+    if((map->mapping = CreateFileMappingA(map->file, NULL, PAGE_WRITECOPY, 0, 0,
+            NULL)) == NULL ||
+            (map->data = MapViewOfFile(map->mapping, FILE_MAP_COPY, 0, 0, 0)) == NULL) {
+        if(map->mapping != NULL) {
+            CloseHandle(map->mapping);
+        }
+        CloseHandle(map->file);
+        errno = ENOMEM;
+        return -1;
+    }
+#else
+    struct stat info;
+    void* data;
+    int fd;
+
+    map->data = NULL;
+
+    if((fd = open(path, O_RDONLY)) < 0) {
+        return -1;
+    }
+
+    if(fstat(fd, &info) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if(!S_ISREG(info.st_mode) || info.st_size == 0) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    map->length = (size_t)info.st_size;
+
+    data = mmap(NULL, map->length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // The mapping holds its own reference to the file
+    close(fd);
+    if(data == MAP_FAILED) {
+        return -1;
+    }
+
+    map->data = data;
+#endif
+
+    return 0;
+}
+
+void mapFileClose(mappedFile* map) {
+    if(map->data == NULL) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(map->data);
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+#else
+    munmap(map->data, map->length);
+#endif
+
+    map->data = NULL;
+    map->length = 0;
+}
@@ -0,0 +1,23 @@
+#ifndef CS430_MAPFILE_H
+#define CS430_MAPFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A whole file mapped into memory. The mapping is private copy-on-write, so
+// pixels inside it may be edited without touching the file on disk.
+typedef struct mappedFile {
+    uint8_t* data;
+    size_t length;
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#endif
+} mappedFile;
+
+// Returns -1 with errno set if the file cannot be opened or mapped, e.g.
+// because it is empty or not a regular file.
+int mapFileOpen(mappedFile* map, const char* path);
+void mapFileClose(mappedFile* map);
+
+#endif // CS430_MAPFILE_H
@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CS430_MIPMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "mipmap.h"
+
+int mipLevelAppend(mipChain* chain, size_t level, const pixel* row);
+
+size_t mipLevelCount(size_t width, size_t height) {
+    size_t count = 1;
+
+    while(width > 1 || height > 1) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        count++;
+    }
+
+    return count;
+}
+
+int mipChainInit(mipChain* chain, size_t width, size_t height) {
+    memset(chain, 0, sizeof(*chain));
+
+    chain->levelCount = mipLevelCount(width, height);
+    if((chain->levels = calloc(chain->levelCount, sizeof(*chain->levels))) == NULL ||
+            (chain->sums = malloc(sizeof(*chain->sums) * 3 * width)) == NULL ||
+            (chain->scratch = malloc(sizeof(*chain->scratch) * width)) == NULL) {
+        mipChainFree(chain);
+        return -1;
+    }
+
+    for(size_t i = 0; i < chain->levelCount; i++) {
+        mipLevel* level = &chain->levels[i];
+
+        level->width = width;
+        level->height = height;
+        if((level->carry = malloc(sizeof(*level->carry) * width)) == NULL) {
+            mipChainFree(chain);
+            return -1;
+        }
+
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    return 0;
+}
+
+int mipChainPush(mipChain* chain, const pixel* row) {
+    return mipLevelAppend(chain, 0, row);
+}
+
+int mipLevelAppend(mipChain* chain, size_t index, const pixel* row) {
+    mipLevel* level = &chain->levels[index];
+    pixel* stored;
+
+    if(level->count == level->capacity) {
+        size_t capacity = level->capacity == 0 ? 8 : level->capacity * 2;
+        pixel* grown;
+
+        if((grown = realloc(level->pixels, sizeof(*grown) * level->width *
+                capacity)) == NULL) {
+            return -1;
+        }
+        level->pixels = grown;
+        level->capacity = capacity;
+    }
+
+    if(level->count == 0) {
+        level->firstRow = level->nextRow;
+    }
+    stored = level->pixels + level->count * level->width;
+    memcpy(stored, row, sizeof(*stored) * level->width);
+    level->count++;
+    level->nextRow++;
+
+    if(index + 1 == chain->levelCount) {
+        return 0;
+    }
+
+    // Appending copies the filtered row out before scratch is reused below
+    if(level->height == 1) {
+        // A level one row tall only narrows, so each row is filtered alone
+        mipFilterRows(stored, stored, level->width, chain->scratch, chain->sums);
+        return mipLevelAppend(chain, index + 1, chain->scratch);
+    }
+
+    if(!level->hasCarry) {
+        memcpy(level->carry, stored, sizeof(*stored) * level->width);
+        level->hasCarry = 1;
+        return 0;
+    }
+
+    level->hasCarry = 0;
+    mipFilterRows(level->carry, stored, level->width, chain->scratch, chain->sums);
+
+    return mipLevelAppend(chain, index + 1, chain->scratch);
+}
+
+void mipChainClear(mipChain* chain) {
+    for(size_t i = 0; i < chain->levelCount; i++) {
+        chain->levels[i].count = 0;
+    }
+}
+
+void mipChainFree(mipChain* chain) {
+    if(chain->levels != NULL) {
+        for(size_t i = 0; i < chain->levelCount; i++) {
+            free(chain->levels[i].pixels);
+            free(chain->levels[i].carry);
+        }
+    }
+    free(chain->levels);
+    free(chain->sums);
+    free(chain->scratch);
+
+    memset(chain, 0, sizeof(*chain));
+}
+
+void mipFilterRows(const pixel* a, const pixel* b, size_t inWidth, pixel* out,
+        uint16_t* sums) {
+    const unsigned char* rowA = (const unsigned char*)a;
+    const unsigned char* rowB = (const unsigned char*)b;
+    size_t bytes = 3 * inWidth;
+    size_t i = 0;
+
+    // Vertical sums first, which are contiguous bytes and vectorize cleanly
+#ifdef CS430_MIPMAP_SSE2
+    __m128i zero = _mm_setzero_si128();
+
+    for(; i + 16 <= bytes; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(rowA + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(rowB + i));
+
+        _mm_storeu_si128((__m128i*)(sums + i), _mm_add_epi16(
+            _mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)));
+        _mm_storeu_si128((__m128i*)(sums + i + 8), _mm_add_epi16(
+            _mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero)));
+    }
+#endif
+    for(; i < bytes; i++) {
+        sums[i] = (uint16_t)(rowA[i] + rowB[i]);
+    }
+
+    // Then neighbouring pixels, three bytes apart, rounding to nearest
+    for(size_t x = 0; x < inWidth / 2; x++) {
+        const uint16_t* s = sums + 6 * x;
+
+        out[x].red = (unsigned char)((s[0] + s[3] + 2) >> 2);
+        out[x].green = (unsigned char)((s[1] + s[4] + 2) >> 2);
+        out[x].blue = (unsigned char)((s[2] + s[5] + 2) >> 2);
+    }
+
+    // A last unpaired column only has its two rows to average
+    if(inWidth % 2 == 1) {
+        const uint16_t* s = sums + 3 * (inWidth - 1);
+
+        out[inWidth / 2].red = (unsigned char)((s[0] + 1) >> 1);
+        out[inWidth / 2].green = (unsigned char)((s[1] + 1) >> 1);
+        out[inWidth / 2].blue = (unsigned char)((s[2] + 1) >> 1);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef CS430_MIPMAP_H
+#define CS430_MIPMAP_H
+
+#include <stdint.h>
+
+#include "pnm.h"
+
+// One level of a mip chain. Rows produced since the last mipChainClear are
+// collected in pixels, starting at level row firstRow, so they can be
+// uploaded together.
+typedef struct mipLevel {
+    size_t width;
+    size_t height;
+    pixel* pixels;
+    size_t firstRow;
+    size_t count;
+    size_t capacity;
+    // The even row of a pair waiting for its odd partner
+    pixel* carry;
+    int hasCarry;
+    size_t nextRow;
+} mipLevel;
+
+// Builds every mip level of a power of two sized image from its rows as they
+// arrive, keeping one carry row per level rather than the image itself. Each
+// level is a 2x2 box filter of the one above, down to 1x1.
+typedef struct mipChain {
+    size_t levelCount;
+    mipLevel* levels;
+    uint16_t* sums;
+    pixel* scratch;
+} mipChain;
+
+// Number of levels from width x height down to 1x1.
+size_t mipLevelCount(size_t width, size_t height);
+int mipChainInit(mipChain* chain, size_t width, size_t height);
+// Appends the next level 0 row, which must be chain->levels[0].width wide,
+// and every lower level row it completes.
+int mipChainPush(mipChain* chain, const pixel* row);
+// Forgets the collected rows once they have been consumed.
+void mipChainClear(mipChain* chain);
+void mipChainFree(mipChain* chain);
+
+// Box filters rows a and b, inWidth pixels each, into one row of
+// (inWidth + 1) / 2 pixels. An odd last column averages the two rows only.
+// sums needs 3 * inWidth entries.
+void mipFilterRows(const pixel* a, const pixel* b, size_t inWidth, pixel* out,
+    uint16_t* sums);
+
+#endif // CS430_MIPMAP_H
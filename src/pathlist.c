@@ -0,0 +1,182 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pathlist.h"
+
+int pathListAddJoined(pathList* list, const char* directory, const char* name);
+int pathHasImageExtension(const char* name);
+int pathCompare(const void* a, const void* b);
+
+void pathListInit(pathList* list) {
+    list->paths = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+int pathListAdd(pathList* list, const char* path) {
+    return pathListAddJoined(list, NULL, path);
+}
+
+int pathListDirectory(pathList* list, const char* directory) {
+    size_t first = list->count;
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find;
+    char* pattern;
+
+    if((pattern = malloc(strlen(directory) + 3)) == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    strcpy(pattern, directory);
+    strcat(pattern, "\\*");
+
+    find = FindFirstFileA(pattern, &entry);
+    free(pattern);
+    if(find == INVALID_HANDLE_VALUE) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    do {
+        if(!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+                pathHasImageExtension(entry.cFileName) &&
+                pathListAddJoined(list, directory, entry.cFileName) < 0) {
+            FindClose(find);
+            errno = ENOMEM;
+            return -1;
+        }
+    } while(FindNextFileA(find, &entry));
+
+    FindClose(find);
+#else
+    struct dirent* entry;
+    DIR* dir;
+
+    if((dir = opendir(directory)) == NULL) {
+        return -1;
+    }
+
+    while((entry = readdir(dir)) != NULL) {
+        if(!pathHasImageExtension(entry->d_name)) {
+            continue;
+        }
+
+        if(pathListAddJoined(list, directory, entry->d_name) < 0) {
+            closedir(dir);
+            errno = ENOMEM;
+            return -1;
+        }
+
+        // A directory can be named like an image too
+        if(pathIsDirectory(list->paths[list->count - 1])) {
+            free(list->paths[--list->count]);
+        }
+    }
+
+    closedir(dir);
+#endif
+
+    // Directory order is arbitrary; name order is what a sequence of frames
+    // is usually numbered in
+    qsort(list->paths + first, list->count - first, sizeof(*list->paths),
+        pathCompare);
+
+    return 0;
+}
+
+void pathListFree(pathList* list) {
+    for(size_t i = 0; i < list->count; i++) {
+        free(list->paths[i]);
+    }
+    free(list->paths);
+
+    pathListInit(list);
+}
+
+int pathIsDirectory(const char* path) {
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+
+    return attributes != INVALID_FILE_ATTRIBUTES &&
+        (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat info;
+
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+int pathListAddJoined(pathList* list, const char* directory, const char* name) {
+    size_t length = strlen(name) + (directory != NULL ? strlen(directory) + 1 : 0);
+    char* path;
+
+    if(list->count == list->capacity) {
+        size_t capacity = list->capacity == 0 ? 16 : list->capacity * 2;
+        char** grown;
+
+        if((grown = realloc(list->paths, sizeof(*grown) * capacity)) == NULL) {
+            return -1;
+        }
+        list->paths = grown;
+        list->capacity = capacity;
+    }
+
+    if((path = malloc(length + 1)) == NULL) {
+        return -1;
+    }
+
+    path[0] = '\0';
+    if(directory != NULL) {
+        strcpy(path, directory);
+#ifdef _WIN32
+        strcat(path, "\\");
+#else
+        strcat(path, "/");
+#endif
+    }
+    strcat(path, name);
+
+    list->paths[list->count++] = path;
+
+    return 0;
+}
+
+int pathHasImageExtension(const char* name) {
+    static const char* const extensions[] = { ".pgm", ".ppm", ".pnm" };
+    size_t length = strlen(name);
+
+    if(length < 4) {
+        return 0;
+    }
+
+    for(size_t i = 0; i < sizeof(extensions) / sizeof(*extensions); i++) {
+        size_t j;
+
+        for(j = 0; j < 4; j++) {
+            if(tolower((unsigned char)name[length - 4 + j]) != extensions[i][j]) {
+                break;
+            }
+        }
+        if(j == 4) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int pathCompare(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
@@ -0,0 +1,24 @@
+#ifndef CS430_PATHLIST_H
+#define CS430_PATHLIST_H
+
+#include <stddef.h>
+
+// A growable list of heap-allocated paths.
+typedef struct pathList {
+    char** paths;
+    size_t count;
+    size_t capacity;
+} pathList;
+
+void pathListInit(pathList* list);
+// Appends a copy of path.
+int pathListAdd(pathList* list, const char* path);
+// Appends the PNM files (.pgm, .ppm or .pnm, in any case) directly
+// inside directory, joined onto it and sorted by name. Subdirectories are not
+// searched. Returns -1 with errno set if the directory cannot be read.
+int pathListDirectory(pathList* list, const char* directory);
+void pathListFree(pathList* list);
+
+int pathIsDirectory(const char* path);
+
+#endif // CS430_PATHLIST_H
@@ -7,7 +7,8 @@
 #define CS430_PNM_BITMAP_MAX 255
 #define CS430_PNM_GREY_MAX 65535
 #define CS430_PNM_FULL_MAX 65535
-#define CS430_PNM_MAX_SUPPORTED 255
+#define CS430_PNM_BYTE_MAX 255
+#define CS430_PNM_MAX_SUPPORTED 65535
 #define CS430_WIDTH_MIN 1
 #define CS430_HEIGHT_MIN 1
 #define CS430_MAX_LINE 70
@@ -25,4 +26,14 @@ typedef struct pixel {
     unsigned char blue;
 } pixel;
 
+// A window onto pixels owned by something else: a whole image, a crop of one,
+// or a mapped file. stride is the distance in pixels between the starts of
+// consecutive rows, so sub-rectangles need no copying.
+typedef struct imageView {
+    pixel* pixels;
+    size_t width;
+    size_t height;
+    size_t stride;
+} imageView;
+
 #endif // CS430_PNM_H
@@ -0,0 +1,448 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+#include "thread.h"
+#include "trace.h"
+
+#define CS430_DEQUE_MIN 64
+#define CS430_CHUNKS_PER_THREAD 4
+
+typedef struct poolTask {
+    poolTaskFn fn;
+    void* arg;
+    poolGroup* group;
+} poolTask;
+
+// Ring buffer of tasks. The owner pushes and pops at the tail (LIFO, so it
+// keeps working on what it just split), while thieves take from the head
+// (FIFO, so they get the oldest and usually largest piece of work).
+typedef struct poolDeque {
+    mutex lock;
+    poolTask* tasks;
+    size_t capacity;
+    size_t head;
+    size_t count;
+} poolDeque;
+
+typedef struct poolWorker {
+    threadPool* pool;
+    poolDeque* deque;
+    thread handle;
+    unsigned int seed;
+} poolWorker;
+
+struct threadPool {
+    size_t threadCount;
+    poolWorker* workers;
+    // One deque per worker, plus a final injection deque for submissions from
+    // threads outside the pool.
+    poolDeque* deques;
+    size_t dequeCount;
+
+    volatile long queued;
+    volatile long stealSeed;
+    int stopping;
+
+    mutex sleepLock;
+    condition wake;
+    condition done;
+    size_t sleepingWaiters;
+};
+
+typedef struct poolRangeChunk {
+    poolRangeFn fn;
+    void* arg;
+    size_t begin;
+    size_t end;
+} poolRangeChunk;
+
+static CS430_THREAD_LOCAL poolWorker* currentWorker = NULL;
+
+int dequeInit(poolDeque* deque);
+void dequeDestroy(poolDeque* deque);
+int dequePush(poolDeque* deque, poolTask task);
+int dequePop(poolDeque* deque, poolTask* task);
+int dequeSteal(poolDeque* deque, poolTask* task);
+int poolTake(threadPool* pool, poolDeque* own, unsigned int* seed, poolTask* task);
+void poolRun(threadPool* pool, poolTask task);
+void poolWorkerMain(void* arg);
+void poolRangeTask(void* arg);
+void poolFreeShell(threadPool* pool);
+
+threadPool* poolCreate(size_t threadCount) {
+    threadPool* pool;
+    size_t i;
+
+    if(threadCount == 0) {
+        threadCount = cpuCount();
+    }
+
+    if((pool = calloc(1, sizeof(*pool))) == NULL) {
+        return NULL;
+    }
+
+    pool->threadCount = threadCount;
+    pool->dequeCount = threadCount + 1;
+
+    if((pool->workers = calloc(threadCount, sizeof(*pool->workers))) == NULL ||
+            (pool->deques = calloc(pool->dequeCount, sizeof(*pool->deques))) == NULL) {
+        poolFreeShell(pool);
+        return NULL;
+    }
+
+    // Each step unwinds only what the ones before it set up
+    if(mutexInit(&pool->sleepLock) < 0) {
+        poolFreeShell(pool);
+        return NULL;
+    }
+    if(conditionInit(&pool->wake) < 0) {
+        mutexDestroy(&pool->sleepLock);
+        poolFreeShell(pool);
+        return NULL;
+    }
+    if(conditionInit(&pool->done) < 0) {
+        conditionDestroy(&pool->wake);
+        mutexDestroy(&pool->sleepLock);
+        poolFreeShell(pool);
+        return NULL;
+    }
+
+    for(i = 0; i < pool->dequeCount; i++) {
+        if(dequeInit(&pool->deques[i]) < 0) {
+            while(i-- > 0) {
+                dequeDestroy(&pool->deques[i]);
+            }
+            conditionDestroy(&pool->done);
+            conditionDestroy(&pool->wake);
+            mutexDestroy(&pool->sleepLock);
+            poolFreeShell(pool);
+            return NULL;
+        }
+    }
+
+    for(i = 0; i < threadCount; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].deque = &pool->deques[i];
+        pool->workers[i].seed = (unsigned int)i * 2654435761u + 1;
+
+        if(threadCreate(&pool->workers[i].handle, poolWorkerMain,
+                &pool->workers[i]) < 0) {
+            // Run with however many workers did start
+            pool->threadCount = i;
+            break;
+        }
+    }
+
+    if(pool->threadCount == 0) {
+        poolDestroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void poolDestroy(threadPool* pool) {
+    size_t i;
+
+    if(pool == NULL) {
+        return;
+    }
+
+    mutexLock(&pool->sleepLock);
+    pool->stopping = 1;
+    conditionBroadcast(&pool->wake);
+    mutexUnlock(&pool->sleepLock);
+
+    for(i = 0; i < pool->threadCount; i++) {
+        threadJoin(&pool->workers[i].handle);
+    }
+
+    for(i = 0; i < pool->dequeCount; i++) {
+        dequeDestroy(&pool->deques[i]);
+    }
+
+    conditionDestroy(&pool->done);
+    conditionDestroy(&pool->wake);
+    mutexDestroy(&pool->sleepLock);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
+
+size_t poolThreadCount(const threadPool* pool) {
+    return pool->threadCount;
+}
+
+void poolGroupInit(poolGroup* group) {
+    atomicStore(&group->pending, 0);
+}
+
+int poolSubmit(threadPool* pool, poolGroup* group, poolTaskFn fn, void* arg) {
+    poolTask task = { fn, arg, group };
+    poolDeque* deque;
+
+    if(currentWorker != NULL && currentWorker->pool == pool) {
+        deque = currentWorker->deque;
+    }
+    else {
+        deque = &pool->deques[pool->dequeCount - 1];
+    }
+
+    atomicIncrement(&group->pending);
+    if(dequePush(deque, task) < 0) {
+        atomicDecrement(&group->pending);
+        return -1;
+    }
+    atomicIncrement(&pool->queued);
+
+    // Wake one idle worker, and any waiters sleeping in poolWait so they can
+    // help with the new task instead of idling.
+    mutexLock(&pool->sleepLock);
+    conditionSignal(&pool->wake);
+    if(pool->sleepingWaiters > 0) {
+        conditionBroadcast(&pool->done);
+    }
+    mutexUnlock(&pool->sleepLock);
+
+    return 0;
+}
+
+void poolWait(threadPool* pool, poolGroup* group) {
+    poolDeque* own = NULL;
+    unsigned int seed = (unsigned int)atomicIncrement(&pool->stealSeed);
+    unsigned int* seedPtr = &seed;
+    poolTask task;
+
+    if(currentWorker != NULL && currentWorker->pool == pool) {
+        own = currentWorker->deque;
+        seedPtr = &currentWorker->seed;
+    }
+
+    while(atomicLoad(&group->pending) > 0) {
+        if(poolTake(pool, own, seedPtr, &task)) {
+            poolRun(pool, task);
+            continue;
+        }
+
+        mutexLock(&pool->sleepLock);
+        if(atomicLoad(&group->pending) > 0 && atomicLoad(&pool->queued) == 0) {
+            pool->sleepingWaiters++;
+            conditionWait(&pool->done, &pool->sleepLock);
+            pool->sleepingWaiters--;
+        }
+        mutexUnlock(&pool->sleepLock);
+    }
+}
+
+int poolParallelFor(threadPool* pool, size_t begin, size_t end, size_t grain,
+        poolRangeFn fn, void* arg) {
+    poolRangeChunk* chunks;
+    poolGroup group;
+    size_t chunkCount, i;
+
+    if(begin >= end) {
+        return 0;
+    }
+
+    if(grain == 0) {
+        grain = (end - begin) / (pool->threadCount * CS430_CHUNKS_PER_THREAD);
+        if(grain == 0) {
+            grain = 1;
+        }
+    }
+
+    chunkCount = (end - begin + grain - 1) / grain;
+    // A single chunk gains nothing from a round trip through the deques
+    if(chunkCount == 1) {
+        fn(arg, begin, end);
+        return 0;
+    }
+
+    if((chunks = malloc(sizeof(*chunks) * chunkCount)) == NULL) {
+        return -1;
+    }
+
+    poolGroupInit(&group);
+    for(i = 0; i < chunkCount; i++) {
+        chunks[i].fn = fn;
+        chunks[i].arg = arg;
+        chunks[i].begin = begin + i * grain;
+        chunks[i].end = (end - chunks[i].begin > grain) ? chunks[i].begin + grain : end;
+
+        if(poolSubmit(pool, &group, poolRangeTask, &chunks[i]) < 0) {
+            // Run the remainder inline rather than leave rows undone
+            for(; i < chunkCount; i++) {
+                chunks[i].fn = fn;
+                chunks[i].arg = arg;
+                chunks[i].begin = begin + i * grain;
+                chunks[i].end = (end - chunks[i].begin > grain) ?
+                    chunks[i].begin + grain : end;
+                poolRangeTask(&chunks[i]);
+            }
+            break;
+        }
+    }
+
+    poolWait(pool, &group);
+    free(chunks);
+
+    return 0;
+}
+
+void poolRangeTask(void* arg) {
+    poolRangeChunk* chunk = arg;
+
+    chunk->fn(chunk->arg, chunk->begin, chunk->end);
+}
+
+void poolWorkerMain(void* arg) {
+    poolWorker* worker = arg;
+    threadPool* pool = worker->pool;
+    poolTask task;
+
+    currentWorker = worker;
+    traceThreadName("pool worker");
+
+    for(;;) {
+        if(poolTake(pool, worker->deque, &worker->seed, &task)) {
+            poolRun(pool, task);
+            continue;
+        }
+
+        mutexLock(&pool->sleepLock);
+        while(atomicLoad(&pool->queued) == 0 && !pool->stopping) {
+            conditionWait(&pool->wake, &pool->sleepLock);
+        }
+        if(pool->stopping && atomicLoad(&pool->queued) == 0) {
+            mutexUnlock(&pool->sleepLock);
+            break;
+        }
+        mutexUnlock(&pool->sleepLock);
+    }
+
+    currentWorker = NULL;
+}
+
+int poolTake(threadPool* pool, poolDeque* own, unsigned int* seed, poolTask* task) {
+    size_t start, i;
+
+    if(own != NULL && dequePop(own, task)) {
+        atomicDecrement(&pool->queued);
+        return 1;
+    }
+
+    // xorshift, so concurrent thieves spread out over different victims
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    start = *seed % pool->dequeCount;
+
+    for(i = 0; i < pool->dequeCount; i++) {
+        poolDeque* victim = &pool->deques[(start + i) % pool->dequeCount];
+
+        if(victim != own && dequeSteal(victim, task)) {
+            atomicDecrement(&pool->queued);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void poolRun(threadPool* pool, poolTask task) {
+    task.fn(task.arg);
+
+    // The group may be freed by its waiter as soon as pending hits zero, so it
+    // must not be touched after the decrement.
+    if(atomicDecrement(&task.group->pending) == 0) {
+        mutexLock(&pool->sleepLock);
+        conditionBroadcast(&pool->done);
+        mutexUnlock(&pool->sleepLock);
+    }
+}
+
+int dequeInit(poolDeque* deque) {
+    if((deque->tasks = malloc(sizeof(*deque->tasks) * CS430_DEQUE_MIN)) == NULL) {
+        return -1;
+    }
+
+    deque->capacity = CS430_DEQUE_MIN;
+    deque->head = 0;
+    deque->count = 0;
+
+    return mutexInit(&deque->lock);
+}
+
+void dequeDestroy(poolDeque* deque) {
+    mutexDestroy(&deque->lock);
+    free(deque->tasks);
+    deque->tasks = NULL;
+}
+
+int dequePush(poolDeque* deque, poolTask task) {
+    mutexLock(&deque->lock);
+
+    if(deque->count == deque->capacity) {
+        poolTask* grown;
+        size_t i;
+
+        if((grown = malloc(sizeof(*grown) * deque->capacity * 2)) == NULL) {
+            mutexUnlock(&deque->lock);
+            return -1;
+        }
+
+        // Unwrap the ring so the head starts back at index 0
+        for(i = 0; i < deque->count; i++) {
+            grown[i] = deque->tasks[(deque->head + i) % deque->capacity];
+        }
+
+        free(deque->tasks);
+        deque->tasks = grown;
+        deque->capacity *= 2;
+        deque->head = 0;
+    }
+
+    deque->tasks[(deque->head + deque->count) % deque->capacity] = task;
+    deque->count++;
+
+    mutexUnlock(&deque->lock);
+
+    return 0;
+}
+
+int dequePop(poolDeque* deque, poolTask* task) {
+    int found = 0;
+
+    mutexLock(&deque->lock);
+    if(deque->count > 0) {
+        deque->count--;
+        *task = deque->tasks[(deque->head + deque->count) % deque->capacity];
+        found = 1;
+    }
+    mutexUnlock(&deque->lock);
+
+    return found;
+}
+
+int dequeSteal(poolDeque* deque, poolTask* task) {
+    int found = 0;
+
+    mutexLock(&deque->lock);
+    if(deque->count > 0) {
+        *task = deque->tasks[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        deque->count--;
+        found = 1;
+    }
+    mutexUnlock(&deque->lock);
+
+    return found;
+}
+
+// Frees a pool's allocations once nothing in them is initialized
+void poolFreeShell(threadPool* pool) {
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
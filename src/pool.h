@@ -0,0 +1,38 @@
+#ifndef CS430_POOL_H
+#define CS430_POOL_H
+
+#include <stddef.h>
+
+typedef struct threadPool threadPool;
+
+typedef void (*poolTaskFn)(void* arg);
+typedef void (*poolRangeFn)(void* arg, size_t begin, size_t end);
+
+// A set of submitted tasks that can be waited on together. Must be
+// initialized with poolGroupInit before the first poolSubmit.
+typedef struct poolGroup {
+    volatile long pending;
+} poolGroup;
+
+// Creates a work-stealing pool with one deque per worker thread. Passing 0
+// uses one worker per online CPU.
+threadPool* poolCreate(size_t threadCount);
+// Runs every queued task, then joins and frees the workers.
+void poolDestroy(threadPool* pool);
+size_t poolThreadCount(const threadPool* pool);
+
+void poolGroupInit(poolGroup* group);
+// Queues a task. Submitted from a worker, the task lands on that worker's own
+// deque; from any other thread it lands on the shared injection deque.
+int poolSubmit(threadPool* pool, poolGroup* group, poolTaskFn fn, void* arg);
+// Blocks until every task in the group has finished, running queued tasks on
+// the calling thread in the meantime. Safe to call from inside a task.
+void poolWait(threadPool* pool, poolGroup* group);
+
+// Calls fn over [begin, end) split into chunks of at most grain indices, and
+// waits for all of them. A grain of 0 picks a size that gives each worker a
+// few chunks to steal.
+int poolParallelFor(threadPool* pool, size_t begin, size_t end, size_t grain,
+    poolRangeFn fn, void* arg);
+
+#endif // CS430_POOL_H
@@ -0,0 +1,577 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "mipmap.h"
+#include "pyramid.h"
+#include "thread.h"
+#include "trace.h"
+#include "varint.h"
+#include "view.h"
+
+#define CS430_PYRAMID_MAGIC "PNMPYRM1"
+#define CS430_PYRAMID_MAGIC_SIZE 8
+#define CS430_PYRAMID_FOOTER_SIZE 8
+
+typedef struct pyramidBuilder {
+    FILE* fd;
+    long long written;
+    size_t tileSize;
+    size_t levelCount;
+    pyramidLevel* levels;
+    // One row of tiles per level, filled a row at a time
+    pixel** buffers;
+    size_t* buffered;
+    size_t* produced;
+    size_t* tileRows;
+    threadPool* pool;
+} pyramidBuilder;
+
+typedef struct pyramidFilterJob {
+    const pixel* src;
+    size_t srcWidth;
+    size_t srcRows;
+    pixel* dst;
+    size_t dstWidth;
+    volatile long failed;
+} pyramidFilterJob;
+
+size_t pyramidLevels(size_t width, size_t height, size_t tileSize,
+    pyramidLevel* levels);
+int pyramidFlush(pyramidBuilder* builder, size_t level);
+void pyramidFilterRange(void* arg, size_t begin, size_t end);
+int pyramidWriteDirectory(pyramidBuilder* builder);
+int pyramidSeek(FILE* fd, long long offset, int origin);
+int pyramidReadAt(const tilePyramid* pyramid, void* buffer, size_t length,
+    long long offset);
+void pyramidBuilderFree(pyramidBuilder* builder);
+
+int pyramidBuild(const char* inputPath, const char* outputPath, size_t tileSize,
+        threadPool* pool, readContext* ctx) {
+    FILE* inputFd;
+    pnmHeader header;
+    pyramidBuilder builder;
+    int status = 0;
+
+    memset(&builder, 0, sizeof(builder));
+
+    // Rows are paired within a row of tiles, so it must hold an even number
+    if(tileSize == 0 || tileSize % 2 != 0) {
+        return readContextFail(ctx, READ_ERROR_RANGE, 0,
+            "Tile size must be even and not 0");
+    }
+
+    // Binary mode so that P6 data is not mangled by newline translation
+    if((inputFd = fopen(inputPath, "rb")) == NULL) {
+        return readContextFail(ctx, READ_ERROR_IO, errno, "Cannot open input file");
+    }
+
+    if(readHeader(&header, inputFd, ctx) < 0) {
+        fclose(inputFd);
+        return -1;
+    }
+
+    builder.tileSize = tileSize;
+    builder.pool = pool;
+    builder.levelCount = pyramidLevels(header.width, header.height, tileSize, NULL);
+
+    if((builder.levels = calloc(builder.levelCount, sizeof(*builder.levels))) == NULL ||
+            (builder.buffers = calloc(builder.levelCount, sizeof(*builder.buffers))) == NULL ||
+            (builder.buffered = calloc(builder.levelCount, sizeof(*builder.buffered))) == NULL ||
+            (builder.produced = calloc(builder.levelCount, sizeof(*builder.produced))) == NULL ||
+            (builder.tileRows = calloc(builder.levelCount, sizeof(*builder.tileRows))) == NULL) {
+        pyramidBuilderFree(&builder);
+        fclose(inputFd);
+        return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on pyramid levels");
+    }
+
+    pyramidLevels(header.width, header.height, tileSize, builder.levels);
+
+    for(size_t i = 0; i < builder.levelCount; i++) {
+        pyramidLevel* level = &builder.levels[i];
+
+        if((level->offsets = malloc(sizeof(*level->offsets) * level->columns *
+                level->rows)) == NULL || (builder.buffers[i] = malloc(
+                sizeof(*builder.buffers[i]) * level->width * tileSize)) == NULL) {
+            pyramidBuilderFree(&builder);
+            fclose(inputFd);
+            return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+                "Memory allocation error on pyramid buffers");
+        }
+    }
+
+    if((builder.fd = fopen(outputPath, "wb")) == NULL) {
+        pyramidBuilderFree(&builder);
+        fclose(inputFd);
+        return readContextFail(ctx, READ_ERROR_IO, errno, "Cannot open output file");
+    }
+
+    if(fwrite(CS430_PYRAMID_MAGIC, 1, CS430_PYRAMID_MAGIC_SIZE, builder.fd) !=
+            CS430_PYRAMID_MAGIC_SIZE ||
+            writeVarint(header.width, builder.fd) < 0 ||
+            writeVarint(header.height, builder.fd) < 0 ||
+            writeVarint(tileSize, builder.fd) < 0 ||
+            writeVarint(builder.levelCount, builder.fd) < 0) {
+        status = readContextFail(ctx, READ_ERROR_IO, errno, "Cannot write pyramid");
+    }
+    builder.written = ftell(builder.fd);
+
+    // Level 0 is decoded straight into its row of tiles; every flush then
+    // cascades into the levels below
+    while(status == 0 && builder.produced[0] < header.height) {
+        size_t rows = header.height - builder.produced[0] < tileSize ?
+            header.height - builder.produced[0] : tileSize;
+        imageView band = viewMake(builder.buffers[0], header.width, rows,
+            header.width);
+        double start = traceBegin();
+
+        if(readRows(&header, builder.produced[0], &band, inputFd, ctx) < 0) {
+            status = -1;
+            break;
+        }
+        traceEnd("decodeBand", start);
+
+        builder.buffered[0] = rows;
+        builder.produced[0] += rows;
+        start = traceBegin();
+        if(pyramidFlush(&builder, 0) < 0) {
+            status = readContextFail(ctx, errno == ENOMEM ? READ_ERROR_MEMORY :
+                READ_ERROR_IO, errno, "Cannot write pyramid tiles");
+        }
+        traceEnd("writeTiles", start);
+    }
+
+    if(status == 0 && pyramidWriteDirectory(&builder) < 0) {
+        status = readContextFail(ctx, READ_ERROR_IO, errno,
+            "Cannot write pyramid directory");
+    }
+
+    if(fclose(builder.fd) == EOF && status == 0) {
+        status = readContextFail(ctx, READ_ERROR_IO, errno, "Cannot write pyramid");
+    }
+    builder.fd = NULL;
+
+    pyramidBuilderFree(&builder);
+    fclose(inputFd);
+
+    // Do not leave a truncated container behind
+    if(status < 0) {
+        remove(outputPath);
+    }
+
+    return status;
+}
+
+int pyramidFlush(pyramidBuilder* builder, size_t index) {
+    pyramidLevel* level = &builder->levels[index];
+    size_t rows = builder->buffered[index];
+    size_t tileRow = builder->tileRows[index];
+
+    for(size_t j = 0; j < level->columns; j++) {
+        size_t x = j * builder->tileSize;
+        size_t width = level->width - x < builder->tileSize ?
+            level->width - x : builder->tileSize;
+
+        level->offsets[tileRow * level->columns + j] = builder->written;
+        for(size_t i = 0; i < rows; i++) {
+            if(fwrite(builder->buffers[index] + i * level->width + x,
+                    sizeof(pixel), width, builder->fd) != width) {
+                return -1;
+            }
+        }
+        builder->written += (long long)(sizeof(pixel) * width * rows);
+    }
+
+    builder->buffered[index] = 0;
+    builder->tileRows[index]++;
+
+    if(index + 1 == builder->levelCount) {
+        return 0;
+    }
+
+    // Tile rows are an even number of rows, so pairs never straddle a flush;
+    // only the image's last row can be left without a partner
+    pyramidLevel* next = &builder->levels[index + 1];
+    pyramidFilterJob job = { builder->buffers[index], level->width, rows,
+        builder->buffers[index + 1] + builder->buffered[index + 1] * next->width,
+        next->width, 0 };
+    size_t pairs = (rows + 1) / 2;
+
+    if(builder->pool == NULL || poolParallelFor(builder->pool, 0, pairs, 0,
+            pyramidFilterRange, &job) < 0) {
+        pyramidFilterRange(&job, 0, pairs);
+    }
+    if(atomicLoad(&job.failed)) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    builder->buffered[index + 1] += pairs;
+    builder->produced[index + 1] += pairs;
+
+    if(builder->buffered[index + 1] == builder->tileSize ||
+            builder->produced[index + 1] == next->height) {
+        return pyramidFlush(builder, index + 1);
+    }
+
+    return 0;
+}
+
+void pyramidFilterRange(void* arg, size_t begin, size_t end) {
+    pyramidFilterJob* job = arg;
+    uint16_t* sums;
+    double start = traceBegin();
+
+    if((sums = malloc(sizeof(*sums) * 3 * job->srcWidth)) == NULL) {
+        atomicStore(&job->failed, 1);
+        return;
+    }
+
+    for(size_t i = begin; i < end; i++) {
+        const pixel* a = job->src + 2 * i * job->srcWidth;
+        const pixel* b = 2 * i + 1 < job->srcRows ? a + job->srcWidth : a;
+
+        mipFilterRows(a, b, job->srcWidth, job->dst + i * job->dstWidth, sums);
+    }
+
+    free(sums);
+    traceEnd("filterRows", start);
+}
+
+int pyramidWriteDirectory(pyramidBuilder* builder) {
+    long long directory = builder->written, previous = 0;
+    unsigned char footer[CS430_PYRAMID_FOOTER_SIZE];
+
+    // Tiles were written as their rows completed, so the offsets in level
+    // order jump back and forth; zigzag keeps the negative deltas small too
+    for(size_t i = 0; i < builder->levelCount; i++) {
+        pyramidLevel* level = &builder->levels[i];
+
+        for(size_t j = 0; j < level->columns * level->rows; j++) {
+            long long delta = level->offsets[j] - previous;
+
+            if(writeVarint(((unsigned long long)delta << 1) ^
+                    (unsigned long long)(delta >> 63), builder->fd) < 0) {
+                return -1;
+            }
+            previous = level->offsets[j];
+        }
+    }
+
+    for(int i = 0; i < CS430_PYRAMID_FOOTER_SIZE; i++) {
+        footer[i] = (unsigned char)((unsigned long long)directory >> (8 * i));
+    }
+
+    return fwrite(footer, 1, sizeof(footer), builder->fd) == sizeof(footer) ? 0 : -1;
+}
+
+int pyramidProbe(const char* path) {
+    FILE* inputFd;
+    char magic[CS430_PYRAMID_MAGIC_SIZE];
+    int found;
+
+    if((inputFd = fopen(path, "rb")) == NULL) {
+        return 0;
+    }
+
+    found = fread(magic, 1, sizeof(magic), inputFd) == sizeof(magic) &&
+        memcmp(magic, CS430_PYRAMID_MAGIC, sizeof(magic)) == 0;
+    fclose(inputFd);
+
+    return found;
+}
+
+int pyramidOpen(tilePyramid* pyramid, const char* path, readContext* ctx) {
+    char magic[CS430_PYRAMID_MAGIC_SIZE];
+    unsigned char footer[CS430_PYRAMID_FOOTER_SIZE];
+    unsigned long long width, height, tileSize, levelCount, directory = 0;
+    long long headerEnd, previous = 0;
+
+    memset(pyramid, 0, sizeof(*pyramid));
+
+    if((pyramid->fd = fopen(path, "rb")) == NULL) {
+        return readContextFail(ctx, READ_ERROR_IO, errno, "Cannot open pyramid");
+    }
+#ifdef _WIN32
+    // The CRT's handle is synchronous, and Windows runs reads on those one
+    // at a time whatever offsets they are given
+    if((pyramid->tileFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+            OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL)) == INVALID_HANDLE_VALUE) {
+        pyramid->tileFile = NULL;
+        pyramidClose(pyramid);
+        return readContextFail(ctx, READ_ERROR_IO, 0, "Cannot open pyramid");
+    }
+#endif
+
+    if(fread(magic, 1, sizeof(magic), pyramid->fd) != sizeof(magic) ||
+            memcmp(magic, CS430_PYRAMID_MAGIC, sizeof(magic)) != 0 ||
+            readVarint(&width, pyramid->fd) < 0 ||
+            readVarint(&height, pyramid->fd) < 0 ||
+            readVarint(&tileSize, pyramid->fd) < 0 ||
+            readVarint(&levelCount, pyramid->fd) < 0 ||
+            width == 0 || height == 0 || tileSize == 0 ||
+            levelCount != pyramidLevels(width, height, tileSize, NULL)) {
+        pyramidClose(pyramid);
+        return readContextFail(ctx, READ_ERROR_FORMAT, 0, "Not a valid pyramid");
+    }
+
+    pyramid->width = width;
+    pyramid->height = height;
+    pyramid->tileSize = tileSize;
+    pyramid->levelCount = levelCount;
+    headerEnd = ftell(pyramid->fd);
+
+    if((pyramid->levels = calloc(levelCount, sizeof(*pyramid->levels))) == NULL) {
+        pyramidClose(pyramid);
+        return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on pyramid levels");
+    }
+    pyramidLevels(width, height, tileSize, pyramid->levels);
+
+    if(pyramidSeek(pyramid->fd, -CS430_PYRAMID_FOOTER_SIZE, SEEK_END) < 0 ||
+            fread(footer, 1, sizeof(footer), pyramid->fd) != sizeof(footer)) {
+        pyramidClose(pyramid);
+        return readContextFail(ctx, READ_ERROR_FORMAT, 0, "Pyramid footer is missing");
+    }
+    for(int i = CS430_PYRAMID_FOOTER_SIZE - 1; i >= 0; i--) {
+        directory = directory << 8 | footer[i];
+    }
+
+    if((long long)directory < headerEnd ||
+            pyramidSeek(pyramid->fd, (long long)directory, SEEK_SET) < 0) {
+        pyramidClose(pyramid);
+        return readContextFail(ctx, READ_ERROR_FORMAT, 0,
+            "Pyramid directory offset is out of range");
+    }
+
+    for(size_t i = 0; i < pyramid->levelCount; i++) {
+        pyramidLevel* level = &pyramid->levels[i];
+
+        if((level->offsets = malloc(sizeof(*level->offsets) * level->columns *
+                level->rows)) == NULL) {
+            pyramidClose(pyramid);
+            return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+                "Memory allocation error on pyramid directory");
+        }
+
+        for(size_t j = 0; j < level->columns * level->rows; j++) {
+            unsigned long long zigzag;
+
+            if(readVarint(&zigzag, pyramid->fd) < 0) {
+                pyramidClose(pyramid);
+                return readContextFail(ctx, READ_ERROR_FORMAT, 0,
+                    "Pyramid directory is truncated");
+            }
+
+            previous += (long long)(zigzag >> 1) ^ -(long long)(zigzag & 1);
+            if(previous < headerEnd || previous >= (long long)directory) {
+                pyramidClose(pyramid);
+                return readContextFail(ctx, READ_ERROR_FORMAT, 0,
+                    "Pyramid tile offset is out of range");
+            }
+            level->offsets[j] = previous;
+        }
+    }
+
+    return 0;
+}
+
+void pyramidTileRect(const tilePyramid* pyramid, size_t level, size_t column,
+        size_t row, size_t* x, size_t* y, size_t* width, size_t* height) {
+    const pyramidLevel* info = &pyramid->levels[level];
+
+    *x = column * pyramid->tileSize;
+    *y = row * pyramid->tileSize;
+    *width = info->width - *x < pyramid->tileSize ? info->width - *x :
+        pyramid->tileSize;
+    *height = info->height - *y < pyramid->tileSize ? info->height - *y :
+        pyramid->tileSize;
+}
+
+int pyramidReadTile(tilePyramid* pyramid, size_t level, size_t column, size_t row,
+        const imageView* dst, readContext* ctx) {
+    size_t x, y, width, height;
+    long long offset;
+    int status = 0;
+
+    if(level >= pyramid->levelCount || column >= pyramid->levels[level].columns ||
+            row >= pyramid->levels[level].rows) {
+        return readContextFail(ctx, READ_ERROR_RANGE, 0, "Tile is outside the pyramid");
+    }
+
+    pyramidTileRect(pyramid, level, column, row, &x, &y, &width, &height);
+    if(dst->width != width || dst->height != height) {
+        return readContextFail(ctx, READ_ERROR_RANGE, 0,
+            "Destination does not match the tile size");
+    }
+
+    offset = pyramid->levels[level].offsets[row * pyramid->levels[level].columns +
+        column];
+
+    // Positioned reads leave the stream's own position alone, so readers on
+    // different threads never wait on each other. A tile that fills its
+    // destination's rows exactly is read in one go.
+    if(dst->stride == width) {
+        status = pyramidReadAt(pyramid, viewRow(dst, 0),
+            sizeof(pixel) * width * height, offset);
+    }
+    else {
+        for(size_t i = 0; i < height && status == 0; i++) {
+            status = pyramidReadAt(pyramid, viewRow(dst, i),
+                sizeof(pixel) * width, offset + (long long)(sizeof(pixel) * width * i));
+        }
+    }
+
+    if(status != 0) {
+        return readContextFail(ctx, status > 0 ? READ_ERROR_EOF : READ_ERROR_IO,
+            status > 0 ? 0 : errno, "Cannot read tile");
+    }
+
+    return 0;
+}
+
+void pyramidClose(tilePyramid* pyramid) {
+    if(pyramid->fd != NULL) {
+        fclose(pyramid->fd);
+    }
+#ifdef _WIN32
+    if(pyramid->tileFile != NULL) {
+        CloseHandle(pyramid->tileFile);
+    }
+#endif
+    if(pyramid->levels != NULL) {
+        for(size_t i = 0; i < pyramid->levelCount; i++) {
+            free(pyramid->levels[i].offsets);
+        }
+    }
+    free(pyramid->levels);
+
+    memset(pyramid, 0, sizeof(*pyramid));
+}
+
+size_t pyramidLevels(size_t width, size_t height, size_t tileSize,
+        pyramidLevel* levels) {
+    size_t count = 0;
+
+    for(;;) {
+        if(levels != NULL) {
+            levels[count].width = width;
+            levels[count].height = height;
+            levels[count].columns = (width + tileSize - 1) / tileSize;
+            levels[count].rows = (height + tileSize - 1) / tileSize;
+        }
+        count++;
+
+        if(width <= tileSize && height <= tileSize) {
+            return count;
+        }
+
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+}
+
+int pyramidSeek(FILE* fd, long long offset, int origin) {
+#ifdef _WIN32
+    return _fseeki64(fd, offset, origin) == 0 ? 0 : -1;
+#else
+    return fseeko(fd, (off_t)offset, origin) == 0 ? 0 : -1;
+#endif
+}
+
+// Reads length bytes at offset without moving the stream's position. Returns
+// 1 if the file ends first, or -1 with errno set on an error.
+int pyramidReadAt(const tilePyramid* pyramid, void* buffer, size_t length,
+        long long offset) {
+    unsigned char* cursor = buffer;
+#ifdef _WIN32
+    OVERLAPPED position;
+    int status = 0;
+
+    // Each read waits on its own event, since several may be in flight on
+    // the one handle
+    memset(&position, 0, sizeof(position));
+    if((position.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL)) == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    while(status == 0 && length > 0) {
+        DWORD chunk = length > 0x40000000 ? 0x40000000 : (DWORD)length;
+        DWORD got = 0;
+
+        position.Offset = (DWORD)((unsigned long long)offset & 0xFFFFFFFF);
+        position.OffsetHigh = (DWORD)((unsigned long long)offset >> 32);
+        if(!ReadFile(pyramid->tileFile, cursor, chunk, NULL, &position) &&
+                GetLastError() != ERROR_IO_PENDING) {
+            status = GetLastError() == ERROR_HANDLE_EOF ? 1 : -1;
+        }
+        else if(!GetOverlappedResult(pyramid->tileFile, &position, &got, TRUE)) {
+            status = GetLastError() == ERROR_HANDLE_EOF ? 1 : -1;
+        }
+        else if(got == 0) {
+            status = 1;
+        }
+
+        cursor += got;
+        length -= got;
+        offset += got;
+    }
+
+    CloseHandle(position.hEvent);
+    if(status < 0) {
+        errno = EIO;
+    }
+
+    return status;
+#else
+    int file = fileno(pyramid->fd);
+
+    while(length > 0) {
+        ssize_t got = pread(file, cursor, length, (off_t)offset);
+
+        if(got < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if(got == 0) {
+            return 1;
+        }
+
+        cursor += got;
+        length -= (size_t)got;
+        offset += (long long)got;
+    }
+
+    return 0;
+#endif
+}
+
+void pyramidBuilderFree(pyramidBuilder* builder) {
+    if(builder->levels != NULL) {
+        for(size_t i = 0; i < builder->levelCount; i++) {
+            free(builder->levels[i].offsets);
+        }
+    }
+    if(builder->buffers != NULL) {
+        for(size_t i = 0; i < builder->levelCount; i++) {
+            free(builder->buffers[i]);
+        }
+    }
+    free(builder->levels);
+    free(builder->buffers);
+    free(builder->buffered);
+    free(builder->produced);
+    free(builder->tileRows);
+}
@@ -0,0 +1,64 @@
+#ifndef CS430_PYRAMID_H
+#define CS430_PYRAMID_H
+
+#include <stdio.h>
+
+#include "pnm.h"
+#include "pool.h"
+#include "read.h"
+
+#define CS430_PYRAMID_TILE_SIZE 256
+
+typedef struct pyramidLevel {
+    size_t width;
+    size_t height;
+    size_t columns;
+    size_t rows;
+    // File offset of each tile, in row-major order
+    long long* offsets;
+} pyramidLevel;
+
+// A multi-resolution tile container. Level 0 is the full image and each level
+// after it is a 2x2 box filter of the one before, rounding odd sizes up, down
+// to the first level that fits in a single tile. Every tile is stored as raw
+// RGB triplets clipped to the image, so any one can be read with one seek.
+//
+// Layout: the magic, varint width, height, tile size and level count, the
+// tiles in the order they were produced, a directory of every tile's offset
+// as zigzag varint deltas in level then row-major order, and finally the
+// directory's offset as 8 little-endian bytes.
+typedef struct tilePyramid {
+    FILE* fd;
+#ifdef _WIN32
+    // Opened again for overlapped I/O, so that tile reads run concurrently
+    void* tileFile;
+#endif
+    size_t width;
+    size_t height;
+    size_t tileSize;
+    size_t levelCount;
+    pyramidLevel* levels;
+} tilePyramid;
+
+// Streams inputPath through the row reader and writes its pyramid to
+// outputPath. Memory is bounded by one row of tiles per level, whatever the
+// image's height. The downsampling of each row of tiles runs on the pool,
+// which may be NULL.
+int pyramidBuild(const char* inputPath, const char* outputPath, size_t tileSize,
+    threadPool* pool, readContext* ctx);
+
+// Whether path starts with the pyramid magic, so callers can tell a pyramid
+// from a PNM file before opening it.
+int pyramidProbe(const char* path);
+// Reads a pyramid's header and tile directory; tiles are read on demand.
+int pyramidOpen(tilePyramid* pyramid, const char* path, readContext* ctx);
+// Position and size of a tile within its level.
+void pyramidTileRect(const tilePyramid* pyramid, size_t level, size_t column,
+    size_t row, size_t* x, size_t* y, size_t* width, size_t* height);
+// Reads one tile into dst, which must be exactly the tile's size. Safe to call
+// from several threads on the same open pyramid at once.
+int pyramidReadTile(tilePyramid* pyramid, size_t level, size_t column, size_t row,
+    const imageView* dst, readContext* ctx);
+void pyramidClose(tilePyramid* pyramid);
+
+#endif // CS430_PYRAMID_H
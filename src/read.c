@@ -6,254 +6,633 @@
 #include <errno.h>
 
 #include "read.h"
+#include "source.h"
+#include "trace.h"
+
+int parseHeader(pnmHeader* header, readSource* src, readContext* ctx);
+typedef int (*decodeKernel)(const pnmHeader* header, size_t firstRow,
+    const imageView* dst, readSource* src, readContext* ctx);
+
+decodeKernel selectKernel(const pnmHeader* header);
+int decodeP2(const pnmHeader* header, size_t firstRow, const imageView* dst,
+    readSource* src, readContext* ctx);
+int decodeP2Wide(const pnmHeader* header, size_t firstRow, const imageView* dst,
+    readSource* src, readContext* ctx);
+int decodeP3(const pnmHeader* header, size_t firstRow, const imageView* dst,
+    readSource* src, readContext* ctx);
+int decodeP3Wide(const pnmHeader* header, size_t firstRow, const imageView* dst,
+    readSource* src, readContext* ctx);
+int decodeP5(const pnmHeader* header, size_t firstRow, const imageView* dst,
+    readSource* src, readContext* ctx);
+int decodeP5Wide(const pnmHeader* header, size_t firstRow, const imageView* dst,
+    readSource* src, readContext* ctx);
+int decodeP6(const pnmHeader* header, size_t firstRow, const imageView* dst,
+    readSource* src, readContext* ctx);
+int decodeP6Wide(const pnmHeader* header, size_t firstRow, const imageView* dst,
+    readSource* src, readContext* ctx);
+static int decodeAscii(const pnmHeader* header, size_t firstRow, const imageView* dst,
+    readSource* src, int channels, int wide, readContext* ctx);
+static int decodeAsciiPixel(const pnmHeader* header, pixel* out, readSource* src,
+    int channels, int wide, size_t maxDigits, int isLast, readContext* ctx);
+static int decodeRaw(const pnmHeader* header, const imageView* dst, readSource* src,
+    int channels, int wide, readContext* ctx);
+static void convertRaw(const pnmHeader* header, const unsigned char* row, pixel* out,
+    size_t count, int channels, int wide);
+static unsigned char scaleSample(unsigned long sample, size_t maxColorSize, int wide);
+long readChannel(readSource* src, size_t maxDigits, int isLast, readContext* ctx);
+int skipWhitespace(readSource* src, readContext* ctx);
+int skipLine(readSource* src, readContext* ctx);
+int skipUntilNext(readSource* src, readContext* ctx);
+int getMagicNumber(readSource* src, readContext* ctx);
+long long getNumber(size_t maxDigits, readSource* src, readContext* ctx);
+
+void readContextInit(readContext* ctx) {
+    ctx->code = READ_OK;
+    ctx->offset = -1;
+    ctx->systemError = 0;
+    ctx->message[0] = '\0';
+}
+
+int readContextFail(readContext* ctx, readError code, int systemError,
+        const char* message) {
+    if(ctx->code != READ_OK) {
+        return -1;
+    }
+
+    ctx->code = code;
+    ctx->offset = -1;
+    ctx->systemError = systemError;
+    strncpy(ctx->message, message, sizeof(ctx->message) - 1);
+    ctx->message[sizeof(ctx->message) - 1] = '\0';
+
+    return -1;
+}
+
+const char* readErrorName(readError code) {
+    switch(code) {
+        case READ_OK:
+            return "ok";
+        case READ_ERROR_EOF:
+            return "premature end of file";
+        case READ_ERROR_IO:
+            return "read error";
+        case READ_ERROR_FORMAT:
+            return "malformed input";
+        case READ_ERROR_UNSUPPORTED:
+            return "unsupported format";
+        case READ_ERROR_RANGE:
+            return "value out of range";
+        case READ_ERROR_MEMORY:
+            return "out of memory";
+    }
+
+    return "unknown error";
+}
+
+int readHeader(pnmHeader* header, FILE* inputFd, readContext* ctx) {
+    readSource src = { inputFd, NULL, 0 };
+    double start = traceBegin();
+    int status = parseHeader(header, &src, ctx);
+
+    traceEnd("readHeader", start);
+    return status;
+}
+
+int readBody(const pnmHeader* header, const imageView* dst, FILE* inputFd,
+        readContext* ctx) {
+    readSource src = { inputFd, NULL, 0 };
+    double start;
+    int status;
+
+    if(dst->height != header->height) {
+        return readFail(ctx, &src, READ_ERROR_RANGE,
+            "Destination is %zux%zu but the image is %zux%zu", dst->width,
+            dst->height, header->width, header->height);
+    }
+
+    start = traceBegin();
+    status = parseRows(header, 0, dst, &src, ctx);
+    traceEnd("readBody", start);
+
+    return status;
+}
+
+int readRows(const pnmHeader* header, size_t firstRow, const imageView* dst,
+        FILE* inputFd, readContext* ctx) {
+    readSource src = { inputFd, NULL, 0 };
+
+    return parseRows(header, firstRow, dst, &src, ctx);
+}
+
+int readHeaderSpan(pnmHeader* header, byteSpan* input, readContext* ctx) {
+    readSource src = { NULL, input, 0 };
+    double start = traceBegin();
+    int status = parseHeader(header, &src, ctx);
+
+    traceEnd("readHeader", start);
+    return status;
+}
+
+int readBodySpan(const pnmHeader* header, const imageView* dst, byteSpan* input,
+        readContext* ctx) {
+    readSource src = { NULL, input, 0 };
+    double start;
+    int status;
+
+    if(dst->height != header->height) {
+        return readFail(ctx, &src, READ_ERROR_RANGE,
+            "Destination is %zux%zu but the image is %zux%zu", dst->width,
+            dst->height, header->width, header->height);
+    }
+
+    start = traceBegin();
+    status = parseRows(header, 0, dst, &src, ctx);
+    traceEnd("readBody", start);
+
+    return status;
+}
+
+int readRowsSpan(const pnmHeader* header, size_t firstRow, const imageView* dst,
+        byteSpan* input, readContext* ctx) {
+    readSource src = { NULL, input, 0 };
+
+    return parseRows(header, firstRow, dst, &src, ctx);
+}
+
+size_t rawRowSize(const pnmHeader* header) {
+    size_t sampleSize = header->maxColorSize > CS430_PNM_BYTE_MAX ? 2 : 1;
+
+    switch(header->mode) {
+        case 5:
+            return header->width * sampleSize;
+        case 6:
+            return header->width * 3 * sampleSize;
+    }
+
+    return 0;
+}
+
+int viewBodySpan(const pnmHeader* header, imageView* view, byteSpan* input,
+        readContext* ctx) {
+    readSource src = { NULL, input, 0 };
+    size_t size;
+
+    // Raw 8-bit RGB is byte-for-byte the pixel layout, so it can be used in
+    // place as long as the compiler added no padding to the struct.
+    if(header->mode != 6 || header->maxColorSize > CS430_PNM_BYTE_MAX ||
+            sizeof(pixel) != 3) {
+        return readFail(ctx, &src, READ_ERROR_UNSUPPORTED,
+            "P%d body cannot be viewed in place", header->mode);
+    }
+
+    // A forged header can wrap the size around to something that fits
+    if(header->width > SIZE_MAX / sizeof(*view->pixels) / header->height) {
+        return readFail(ctx, &src, READ_ERROR_RANGE,
+            "%zux%zu pixels is too large", header->width, header->height);
+    }
+    size = header->width * header->height * sizeof(*view->pixels);
+
+    if(input->length - input->offset < size) {
+        input->offset = input->length;
+        src.eof = 1;
+        return readFailStream(ctx, &src, "pixel data");
+    }
 
-int readChannel(pnmHeader header, FILE* inputFd, int isLast);
-int skipWhitespace(FILE* fd);
-int skipLine(FILE* fd);
-int skipUntilNext(FILE* fd);
-int getMagicNumber(FILE* fd);
-long long getNumber(size_t maxDigits, FILE* fd);
+    view->pixels = (pixel*)(input->data + input->offset);
+    view->width = header->width;
+    view->height = header->height;
+    view->stride = header->width;
+    input->offset += size;
 
-int readHeader(pnmHeader* header, FILE* inputFd) {
+    return 0;
+}
+
+int parseHeader(pnmHeader* header, readSource* src, readContext* ctx) {
     long long value;
 
     // Read the magic number, if any
-    if((value = getMagicNumber(inputFd)) < 0) {
+    if((value = getMagicNumber(src, ctx)) < 0) {
         return -1;
     }
     else {
         header->mode = value;
     }
 
-    if(skipUntilNext(inputFd) < 0) {
+    if(skipUntilNext(src, ctx) < 0) {
         return -1;
     }
 
     // Read the width, if there is one.
-    if((value = getNumber(20, inputFd)) < 0) {
+    if((value = getNumber(20, src, ctx)) < 0) {
         return -1;
     }
     else if(value < CS430_WIDTH_MIN) {
-        fprintf(stderr, "Error: Width cannot be less than %d\n", CS430_WIDTH_MIN);
-        return -1;
+        return readFail(ctx, src, READ_ERROR_RANGE,
+            "Width cannot be less than %d", CS430_WIDTH_MIN);
     }
     else {
         header->width = value;
     }
 
-    if(skipUntilNext(inputFd) < 0) {
+    if(skipUntilNext(src, ctx) < 0) {
         return -1;
     }
 
     // Read the height, if there is one.
-    if((value = getNumber(20, inputFd)) < 0) {
+    if((value = getNumber(20, src, ctx)) < 0) {
         return -1;
     }
     else if(value < 1) {
-        fprintf(stderr, "Error: Height cannot be less than %d\n", CS430_HEIGHT_MIN);
-        return -1;
+        return readFail(ctx, src, READ_ERROR_RANGE,
+            "Height cannot be less than %d", CS430_HEIGHT_MIN);
     }
     else {
         header->height = value;
     }
 
-    if(skipUntilNext(inputFd) < 0) {
+    if(skipUntilNext(src, ctx) < 0) {
         return -1;
     }
 
-    if((value = getNumber(5, inputFd)) < 0) {
+    if((value = getNumber(5, src, ctx)) < 0) {
         return -1;
     }
     else if(value < CS430_PNM_MIN) {
-        fprintf(stderr, "Error: Max color value cannot be less than %d.\n",
-            CS430_PNM_MIN);
-        return -1;
+        return readFail(ctx, src, READ_ERROR_RANGE,
+            "Max color value cannot be less than %d", CS430_PNM_MIN);
     }
-    // If the value exceeds 1 byte (8-bits)
+    // If the value exceeds 2 bytes (16-bits)
     else if(value > CS430_PNM_MAX_SUPPORTED) {
-        fprintf(stderr, "Error: Max color value cannot be greater than 1 byte (aka. %d)\n",
+        return readFail(ctx, src, READ_ERROR_UNSUPPORTED,
+            "Max color value cannot be greater than 2 bytes (aka. %d)",
             CS430_PNM_MAX_SUPPORTED);
-        return -1;
     }
     else {
         header->maxColorSize = value;
     }
 
-    if((value = fgetc(inputFd)) == EOF) {
-        // If end-of-file reached and not at the very last pixel
-        if(feof(inputFd)) {
-            fprintf(stderr, "Error: Premature EOF reading pixel data\n");
-            return -1;
-        }
-        // If some read error has occurred
-        else if(ferror(inputFd)) {
-            perror("Error: Read error during pixel data\n");
-            return -1;
-        }
+    if((value = sourceGet(src)) == EOF) {
+        return readFailStream(ctx, src, "pixel data");
     }
 
     if(value == '#') {
         // If next character starts a comment, then skip the remaining
-        while((value == '#' && (value = skipLine(inputFd)) >= CHAR_MIN));
+        while((value == '#' && (value = skipLine(src, ctx)) >= CHAR_MIN));
         if(value < CHAR_MIN) {
             return -1;
         }
-        else if((value = fgetc(inputFd)) == EOF) {
-            // If end-of-file reached and not at the very last pixel
-            if(feof(inputFd)) {
-                fprintf(stderr, "Error: Premature EOF reading pixel data\n");
-                return -1;
-            }
-            // If some read error has occurred
-            else if(ferror(inputFd)) {
-                perror("Error: Read error during pixel data\n");
-                return -1;
-            }
+        else if((value = sourceGet(src)) == EOF) {
+            return readFailStream(ctx, src, "pixel data");
         }
     }
 
     // If character immediately following the max color value or comments is not
     // whitespace, then return on error.
     if(!isspace(value)) {
-        fprintf(stderr, "Error: Pixel values must be preceeded by a single whitespace\n");
-        return -1;
+        return readFail(ctx, src, READ_ERROR_FORMAT,
+            "Pixel values must be preceeded by a single whitespace");
     }
 
     return 0;
 }
 
-int readBody(pnmHeader header, pixel* pixels, FILE* inputFd) {
-    if(header.mode < 1 || header.mode > 7) {
-        fprintf(stderr, "Error: Mode %d not valid\n", header.mode);
-        return -1;
+int parseRows(const pnmHeader* header, size_t firstRow, const imageView* dst,
+        readSource* src, readContext* ctx) {
+    decodeKernel kernel;
+
+    if(header->mode < 1 || header->mode > 7) {
+        return readFail(ctx, src, READ_ERROR_FORMAT,
+            "Mode %d not valid", header->mode);
+    }
+
+    if(dst->width != header->width || firstRow > header->height ||
+            dst->height > header->height - firstRow) {
+        return readFail(ctx, src, READ_ERROR_RANGE,
+            "Rows %zu to %zu of width %zu do not fit a %zux%zu image", firstRow,
+            firstRow + dst->height, dst->width, header->width, header->height);
+    }
+
+    if(dst->height == 0) {
+        return 0;
+    }
+
+    // The only per-image decision; everything below it runs a loop with the
+    // format and sample width fixed.
+    if((kernel = selectKernel(header)) == NULL) {
+        return readFail(ctx, src, READ_ERROR_UNSUPPORTED,
+            "Mode %d not supported", header->mode);
+    }
+
+    return kernel(header, firstRow, dst, src, ctx);
+}
+
+decodeKernel selectKernel(const pnmHeader* header) {
+    int wide = header->maxColorSize > CS430_PNM_BYTE_MAX;
+
+    switch(header->mode) {
+        case 2:
+            return wide ? decodeP2Wide : decodeP2;
+        case 3:
+            return wide ? decodeP3Wide : decodeP3;
+        case 5:
+            return wide ? decodeP5Wide : decodeP5;
+        case 6:
+            return wide ? decodeP6Wide : decodeP6;
     }
 
-    if(header.mode == 3) {
-        int value;
+    return NULL;
+}
+
+int decodeP2(const pnmHeader* header, size_t firstRow, const imageView* dst,
+        readSource* src, readContext* ctx) {
+    return decodeAscii(header, firstRow, dst, src, 1, 0, ctx);
+}
 
-        for(size_t i = 0; i < header.height; i++) {
-            for(size_t j = 0; j < header.width; j++) {
-                if((value = readChannel(header, inputFd, 0)) < 0) {
-                    return -1;
-                }
-                pixels[i * header.width + j].red = value;
+int decodeP2Wide(const pnmHeader* header, size_t firstRow, const imageView* dst,
+        readSource* src, readContext* ctx) {
+    return decodeAscii(header, firstRow, dst, src, 1, 1, ctx);
+}
 
-                if((value = readChannel(header, inputFd, 0)) < 0) {
-                    return -1;
-                }
-                pixels[i * header.width + j].green = value;
+int decodeP3(const pnmHeader* header, size_t firstRow, const imageView* dst,
+        readSource* src, readContext* ctx) {
+    return decodeAscii(header, firstRow, dst, src, 3, 0, ctx);
+}
 
-                if((value = readChannel(header, inputFd, (i == header.height - 1) &&
-                        (j == header.width - 1))) < 0) {
-                    return -1;
-                }
-                pixels[i * header.width + j].blue = value;
+int decodeP3Wide(const pnmHeader* header, size_t firstRow, const imageView* dst,
+        readSource* src, readContext* ctx) {
+    return decodeAscii(header, firstRow, dst, src, 3, 1, ctx);
+}
+
+int decodeP5(const pnmHeader* header, size_t firstRow, const imageView* dst,
+        readSource* src, readContext* ctx) {
+    // Raw rows decode the same wherever they sit in the image
+    (void)firstRow;
+    return decodeRaw(header, dst, src, 1, 0, ctx);
+}
+
+int decodeP5Wide(const pnmHeader* header, size_t firstRow, const imageView* dst,
+        readSource* src, readContext* ctx) {
+    (void)firstRow;
+    return decodeRaw(header, dst, src, 1, 1, ctx);
+}
+
+int decodeP6(const pnmHeader* header, size_t firstRow, const imageView* dst,
+        readSource* src, readContext* ctx) {
+    (void)firstRow;
+
+    // 8-bit RGB already is the pixel layout, so rows go straight to their
+    // destination with no conversion pass.
+    if(sizeof(pixel) == 3) {
+        size_t rowSize = header->width * sizeof(*dst->pixels);
+
+        for(size_t i = 0; i < dst->height; i++) {
+            if(sourceRead(src, &dst->pixels[i * dst->stride], rowSize) != rowSize) {
+                return readFailStream(ctx, src, "pixel data");
             }
         }
+
+        return 0;
     }
-    else if(header.mode == 6) {
-        // Loop through the following raw binary in the file with the image
-        // represented from top-to-bottom going row-by-row
-        for(size_t i = 0; i < header.height; i++) {
-            for(size_t j = 0; j < header.width; j++) {
-                fread(&(pixels[i * header.width + j].red), 1, 1, inputFd);
-                fread(&(pixels[i * header.width + j].green), 1, 1, inputFd);
-                fread(&(pixels[i * header.width + j].blue), 1, 1, inputFd);
+
+    return decodeRaw(header, dst, src, 3, 0, ctx);
+}
+
+int decodeP6Wide(const pnmHeader* header, size_t firstRow, const imageView* dst,
+        readSource* src, readContext* ctx) {
+    (void)firstRow;
+    return decodeRaw(header, dst, src, 3, 1, ctx);
+}
+
+// The generic kernels below are only ever called with constant channels and
+// wide arguments from the wrappers above, so each wrapper compiles into its
+// own loop with those tests folded away.
+static int decodeAscii(const pnmHeader* header, size_t firstRow, const imageView* dst,
+        readSource* src, int channels, int wide, readContext* ctx) {
+    size_t maxDigits = wide ? 5 : 3;
+    size_t lastRow = dst->height - 1;
+    size_t lastColumn = header->width - 1;
+    // Only the final sample of the image may run into end-of-file, so it is
+    // peeled off rather than tested for on every channel.
+    int endsImage = firstRow + dst->height == header->height;
+
+    for(size_t i = 0; i < dst->height; i++) {
+        pixel* out = &dst->pixels[i * dst->stride];
+        size_t columns = (endsImage && i == lastRow) ? lastColumn : header->width;
+
+        for(size_t j = 0; j < columns; j++) {
+            if(decodeAsciiPixel(header, &out[j], src, channels, wide, maxDigits,
+                    0, ctx) < 0) {
+                return -1;
             }
         }
     }
+
+    if(!endsImage) {
+        return 0;
+    }
+
+    return decodeAsciiPixel(header, &dst->pixels[lastRow * dst->stride + lastColumn],
+        src, channels, wide, maxDigits, 1, ctx);
+}
+
+static int decodeAsciiPixel(const pnmHeader* header, pixel* out, readSource* src,
+        int channels, int wide, size_t maxDigits, int isLast, readContext* ctx) {
+    long samples[3];
+
+    for(int c = 0; c < channels; c++) {
+        if((samples[c] = readChannel(src, maxDigits,
+                isLast && c == channels - 1, ctx)) < 0) {
+            return -1;
+        }
+    }
+
+    // One range check per pixel instead of one per channel
+    if(channels == 3) {
+        if((samples[0] > (long)header->maxColorSize) |
+                (samples[1] > (long)header->maxColorSize) |
+                (samples[2] > (long)header->maxColorSize)) {
+            return readFail(ctx, src, READ_ERROR_RANGE,
+                "Pixel value cannot exceed supplied max color value");
+        }
+        out->red = scaleSample(samples[0], header->maxColorSize, wide);
+        out->green = scaleSample(samples[1], header->maxColorSize, wide);
+        out->blue = scaleSample(samples[2], header->maxColorSize, wide);
+    }
     else {
-        fprintf(stderr, "Error: Mode %d not supported\n", header.mode);
-        return -1;
+        if(samples[0] > (long)header->maxColorSize) {
+            return readFail(ctx, src, READ_ERROR_RANGE,
+                "Pixel value cannot exceed supplied max color value");
+        }
+        out->red = out->green = out->blue =
+            scaleSample(samples[0], header->maxColorSize, wide);
     }
 
     return 0;
 }
 
-int skipWhitespace(FILE* fd) {
-    char value;
+static int decodeRaw(const pnmHeader* header, const imageView* dst, readSource* src,
+        int channels, int wide, readContext* ctx) {
+    size_t rowSize = header->width * channels * (wide ? 2 : 1);
+    unsigned char* row;
 
-    // Loop until either EOF or no whitespace remains.
-    while((value = fgetc(fd)) != EOF && isspace(value));
+    if((row = malloc(rowSize)) == NULL) {
+        return readFail(ctx, src, READ_ERROR_MEMORY,
+            "Memory allocation error on row buffer");
+    }
 
-    if(feof(fd)) {
-        fprintf(stderr, "Error: Premature EOF during skip whitespace\n");
-        return CHAR_MIN - 1;
+    for(size_t i = 0; i < dst->height; i++) {
+        pixel* out = &dst->pixels[i * dst->stride];
+
+        if(sourceRead(src, row, rowSize) != rowSize) {
+            free(row);
+            return readFailStream(ctx, src, "pixel data");
+        }
+
+        convertRaw(header, row, out, header->width, channels, wide);
     }
 
-    if(ferror(fd)) {
-        perror("Error: Read error during skip shitespace\n");
-        return CHAR_MIN - 1;
+    free(row);
+
+    return 0;
+}
+
+static void convertRaw(const pnmHeader* header, const unsigned char* row, pixel* out,
+        size_t count, int channels, int wide) {
+    for(size_t j = 0; j < count; j++) {
+        unsigned int samples[3];
+
+        for(int c = 0; c < channels; c++) {
+            // Wide samples are stored most significant byte first
+            samples[c] = wide ?
+                (unsigned int)row[(j * channels + c) * 2] << 8 |
+                    row[(j * channels + c) * 2 + 1] :
+                row[j * channels + c];
+            samples[c] = samples[c] > header->maxColorSize ?
+                (unsigned int)header->maxColorSize : samples[c];
+        }
+
+        out[j].red = scaleSample(samples[0], header->maxColorSize, wide);
+        out[j].green = scaleSample(samples[channels == 3 ? 1 : 0],
+            header->maxColorSize, wide);
+        out[j].blue = scaleSample(samples[channels == 3 ? 2 : 0],
+            header->maxColorSize, wide);
     }
+}
 
-    return value;
+void convertRawPixels(const pnmHeader* header, const unsigned char* samples,
+        pixel* out, size_t count) {
+    int wide = header->maxColorSize > CS430_PNM_BYTE_MAX;
+
+    // Dispatch once per call to a loop with the layout fixed, as parseRows does
+    if(header->mode == 5) {
+        if(wide) {
+            convertRaw(header, samples, out, count, 1, 1);
+        }
+        else {
+            convertRaw(header, samples, out, count, 1, 0);
+        }
+    }
+    else if(wide) {
+        convertRaw(header, samples, out, count, 3, 1);
+    }
+    else {
+        convertRaw(header, samples, out, count, 3, 0);
+    }
 }
 
-int skipLine(FILE* fd) {
-    char value;
+// 8-bit samples are stored as-is, as they always have been; 16-bit samples
+// are rescaled so that maxColorSize maps to 255.
+static unsigned char scaleSample(unsigned long sample, size_t maxColorSize, int wide) {
+    if(!wide) {
+        return (unsigned char)sample;
+    }
 
-    while((value = fgetc(fd)) != EOF && value != '\n' && value != '\r');
+    return (unsigned char)((sample * CS430_PNM_BYTE_MAX + maxColorSize / 2) /
+        maxColorSize);
+}
+
+int skipWhitespace(readSource* src, readContext* ctx) {
+    int value;
+
+    // Loop until either EOF or no whitespace remains.
+    while((value = sourceGet(src)) != EOF && isspace(value));
 
-    if(feof(fd)) {
-        fprintf(stderr, "Error: Premature EOF during skip line\n");
+    if(sourceEof(src) || sourceError(src)) {
+        readFailStream(ctx, src, "skip whitespace");
         return CHAR_MIN - 1;
     }
 
-    if(ferror(fd)) {
-        perror("Error: Read error during skip line\n");
+    return value;
+}
+
+int skipLine(readSource* src, readContext* ctx) {
+    int value;
+
+    while((value = sourceGet(src)) != EOF && value != '\n' && value != '\r');
+
+    if(sourceEof(src) || sourceError(src)) {
+        readFailStream(ctx, src, "skip line");
         return CHAR_MIN - 1;
     }
 
     return value;
 }
 
-int skipUntilNext(FILE* fd) {
+int skipUntilNext(readSource* src, readContext* ctx) {
     int value;
 
     // Continue skipping whitespace and comments until an error occurs or no
     // more comments exist.
-    while((value = skipWhitespace(fd)) < CHAR_MIN ||
-        (value == '#' && (value = skipLine(fd)) < CHAR_MIN));
+    while((value = skipWhitespace(src, ctx)) < CHAR_MIN ||
+        (value == '#' && (value = skipLine(src, ctx)) < CHAR_MIN));
     if(value < CHAR_MIN) {
         return -1;
     }
 
-    if((value != '\n' && value != '\r') && ungetc(value, fd) == EOF) {
-        perror("Error: Read error during unget newline\n");
-        return -1;
+    if((value != '\n' && value != '\r') && sourceUnget(src, value) == EOF) {
+        return readFail(ctx, src, READ_ERROR_IO, "Read error during unget newline");
     }
 
     return 0;
 }
 
-int getMagicNumber(FILE* fd) {
+int getMagicNumber(readSource* src, readContext* ctx) {
     char buffer[3] = { '\0' };
+    int value;
 
-    if(fgets(buffer, 3, fd) == NULL) {
-        fprintf(stderr, "Error: Empty file\n");
-        return -1;
+    // Read up to two characters, stopping early at a newline (as fgets would)
+    if((value = sourceGet(src)) == EOF) {
+        if(sourceError(src)) {
+            return readFailStream(ctx, src, "magic number");
+        }
+        return readFail(ctx, src, READ_ERROR_EOF, "Empty file");
+    }
+    buffer[0] = value;
+
+    if(value != '\n' && (value = sourceGet(src)) != EOF) {
+        buffer[1] = value;
     }
 
     if(strlen(buffer) < 2) {
-        fprintf(stderr, "Error: Magic number less than two characters\n");
-        return -1;
+        return readFail(ctx, src, READ_ERROR_FORMAT,
+            "Magic number less than two characters");
     }
 
     if(buffer[0] != 'P' || buffer[1] < '1' || buffer[1] > '7') {
-        fprintf(stderr, "Error: File lacks one of the correct magic numbers P1-P7\n");
-        return -1;
+        return readFail(ctx, src, READ_ERROR_FORMAT,
+            "File lacks one of the correct magic numbers P1-P7");
     }
 
-    if(buffer[1] != '3' && buffer[1] != '6') {
-        fprintf(stderr, "Error: P%c not supported\n", buffer[1]);
-        return -1;
+    if(buffer[1] != '2' && buffer[1] != '3' && buffer[1] != '5' && buffer[1] != '6') {
+        return readFail(ctx, src, READ_ERROR_UNSUPPORTED,
+            "P%c not supported", buffer[1]);
     }
 
     // Convert ASCII to single-digit number.
     return buffer[1] - '0';
 }
 
-long long getNumber(size_t maxDigits, FILE* fd) {
+long long getNumber(size_t maxDigits, readSource* src, readContext* ctx) {
     char buffer[64] = { '\0' };
     char* endptr;
     size_t i = 0;
@@ -262,134 +641,108 @@ long long getNumber(size_t maxDigits, FILE* fd) {
 
     // Continue to read character-by-character until end-of-buffer reached,
     // or end-of-file / read error reached, or some non-decimal is reached.
-    while(i < maxDigits && (value = fgetc(fd)) != EOF &&
+    while(i < maxDigits && (value = sourceGet(src)) != EOF &&
             isdigit(value)) {
         buffer[i++] = value;
     }
 
     if(value == EOF) {
-        // If end-of-file reached and not at the very last pixel
-        if(feof(fd)) {
-            fprintf(stderr, "Error: Premature EOF in header\n");
-            return -1;
+        return readFailStream(ctx, src, "header");
+    }
+
+    // If the loop stopped on the digit limit, the last character read is part
+    // of the number; peek at the one after it instead of ungetting that digit.
+    if(i == maxDigits && isdigit(value)) {
+        if((value = sourceGet(src)) == EOF) {
+            return readFailStream(ctx, src, "header");
         }
-        // If some read error has occurred
-        else if(ferror(fd)) {
-            perror("Error: Read error during header\n");
-            return -1;
+        else if(isdigit(value)) {
+            return readFail(ctx, src, READ_ERROR_RANGE,
+                "Value longer than %zu digits", maxDigits);
         }
     }
 
-    if(ungetc(value, fd) == EOF) {
-        perror("Error: Read error on ungetc\n");
-        return -1;
+    if(sourceUnget(src, value) == EOF) {
+        return readFail(ctx, src, READ_ERROR_IO, "Read error on ungetc");
     }
 
+    // strtoll only ever sets errno, so clear whatever a previous call left
+    // behind before checking for ERANGE below.
+    errno = 0;
     value = strtoll(buffer, &endptr, 10);
     // If the first character is not empty and the set first invalid
     // character is empty, then the whole string is valid. (see 'man strtol')
     // Otherwise, part of the string is not a number.
     if(!(*buffer != '\0' && *endptr == '\0')) {
-        fprintf(stderr, "Error: Invalid value (non-decimal)\n");
-        return -1;
+        return readFail(ctx, src, READ_ERROR_FORMAT, "Invalid value (non-decimal)");
     }
 
     if(errno == ERANGE) {
         if(value == LLONG_MAX) {
-            fprintf(stderr, "Error: Value larger than %lld\n", LLONG_MAX);
+            return readFail(ctx, src, READ_ERROR_RANGE,
+                "Value larger than %lld", LLONG_MAX);
         }
         else {
-            fprintf(stderr, "Error: Value smaller than %lld\n", LLONG_MIN);
+            return readFail(ctx, src, READ_ERROR_RANGE,
+                "Value smaller than %lld", LLONG_MIN);
         }
-
-        return -1;
     }
 
     return value;
 }
 
-int readChannel(pnmHeader header, FILE* inputFd, int isLast) {
-    char buffer[4] = { '\0' };
-    char* endptr;
-    int value, i = 0;
-    // Continue to read character-by-character until end-of-buffer reached,
-    // or end-of-file / read error reached, or some non-decimal is reached.
-    while((size_t)i < sizeof(buffer) - 1 && (value = fgetc(inputFd)) != EOF &&
-            isdigit(value)) {
-        buffer[i++] = value;
-    }
-
-    if(value == EOF) {
-        // If end-of-file reached and not at the very last pixel
-        if(!isLast && feof(inputFd)) {
-            fprintf(stderr, "Error: Premature EOF reading pixel data\n");
-            return -1;
-        }
-        // If some read error has occurred
-        else if(ferror(inputFd)) {
-            perror("Error: Read error during pixel data\n");
-            return -1;
+long readChannel(readSource* src, size_t maxDigits, int isLast, readContext* ctx) {
+    long value = 0;
+    size_t digits = 0;
+    int c = EOF;
+    // Continue to read character-by-character until the digit limit is
+    // reached, or end-of-file / read error reached, or some non-decimal is
+    // reached, accumulating the value as we go.
+    while(digits < maxDigits && (c = sourceGet(src)) != EOF && isdigit(c)) {
+        value = value * 10 + (c - '0');
+        digits++;
+    }
+
+    if(c == EOF) {
+        // End-of-file is only acceptable right after the very last pixel
+        if((!isLast && sourceEof(src)) || sourceError(src)) {
+            return readFailStream(ctx, src, "pixel data");
         }
     }
     // If there isn't at least some whitespace inbetween each pixel
     // and not at the very last pixel
     else if(!isLast) {
-        // If the last read character is a digit still (if the number read is 3
-        // digits long out of the 4 possible bytes), then get the next
-        // character to use for whitespace check instead
-        if(isdigit(value)) {
-            value = fgetc(inputFd);
-
-            if(value == EOF) {
-                // If end-of-file reached
-                if(feof(inputFd)) {
-                    fprintf(stderr, "Error: Premature EOF reading pixel data\n");
-                    return -1;
-                }
-                // If some read error has occurred
-                else if(ferror(inputFd)) {
-                    perror("Error: Read error during pixel data\n");
-                    return -1;
-                }
+        // If the last read character is a digit still (if the number read is
+        // maxDigits long), then get the next character to use for whitespace
+        // check instead
+        if(isdigit(c)) {
+            if((c = sourceGet(src)) == EOF) {
+                return readFailStream(ctx, src, "pixel data");
             }
         }
 
         // Check if at least one whitespace splits channel data
-        if(!isspace(value)) {
-            fprintf(stderr, "Error: There must be at least one whitespace "
-                "character inbetween pixel data\n");
-            return -1;
+        if(!isspace(c)) {
+            return readFail(ctx, src, READ_ERROR_FORMAT,
+                "There must be at least one whitespace character inbetween "
+                "pixel data");
         }
 
         // Skip remaining potential whitespace inbetween channels
-        if((value = skipWhitespace(inputFd)) < 0) {
+        if((c = skipWhitespace(src, ctx)) < 0) {
             return -1;
         }
 
         // Undo the first digit of the next channel value
-        if(ungetc(value, inputFd) == EOF) {
-            fprintf(stderr, "Error: Read error ungetting digit in pixel data\n");
-            return -1;
+        if(sourceUnget(src, c) == EOF) {
+            return readFail(ctx, src, READ_ERROR_IO,
+                "Read error ungetting digit in pixel data");
         }
     }
 
-    value = strtol(buffer, &endptr, 10);
-    // If the first character is not empty and the set first invalid
-    // character is empty, then the whole string is valid. (see 'man strtol')
-    // Otherwise, part of the string is not a number.
-    if(!(*buffer != '\0' && *endptr == '\0')) {
-        fprintf(stderr, "Error: Invalid decimal value on channel\n");
-        return -1;
-    }
-
-    if(value < 0) {
-        fprintf(stderr, "Error: Pixel value cannot be less than 0\n");
-        return -1;
-    }
-    else if((size_t)value > header.maxColorSize) {
-        fprintf(stderr, "Error: Pixel value cannot exceed supplied "
-            "max color value\n");
-        return -1;
+    if(digits == 0) {
+        return readFail(ctx, src, READ_ERROR_FORMAT,
+            "Invalid decimal value on channel");
     }
 
     return value;
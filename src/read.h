@@ -2,10 +2,82 @@
 #define CS430_PNM_READ_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 #include "pnm.h"
 
-int readHeader(pnmHeader* header, FILE* inputFd);
-int readBody(pnmHeader header, pixel* pixels, FILE* inputFd);
+#define CS430_READ_MESSAGE_MAX 128
+
+typedef enum readError {
+    READ_OK = 0,
+    // Input ended before the header or pixel data was complete
+    READ_ERROR_EOF,
+    // The underlying stream failed; see systemError for the errno value
+    READ_ERROR_IO,
+    // The input is not well-formed PNM
+    READ_ERROR_FORMAT,
+    // Well-formed, but a mode or depth this reader does not handle
+    READ_ERROR_UNSUPPORTED,
+    // A value is outside its allowed range
+    READ_ERROR_RANGE,
+    READ_ERROR_MEMORY
+} readError;
+
+// Per-call parse state. Nothing in the reader writes to stderr or depends on
+// shared state, so any number of decodes may run at once as long as each has
+// its own context. Only the first error is kept.
+typedef struct readContext {
+    readError code;
+    // Byte offset into the input at which the error was detected, or -1 if it
+    // could not be determined
+    long long offset;
+    int systemError;
+    char message[CS430_READ_MESSAGE_MAX];
+} readContext;
+
+// A PNM payload already in memory. offset is the parse cursor: the span
+// readers start at it and leave it just past whatever they consumed, so a
+// header read positions it at the start of the pixel data.
+typedef struct byteSpan {
+    const uint8_t* data;
+    size_t length;
+    size_t offset;
+} byteSpan;
+
+void readContextInit(readContext* ctx);
+// Records an error found outside the parser itself (opening a file, allocating
+// pixels) so that every load failure is reported through the same context.
+// Always returns -1.
+int readContextFail(readContext* ctx, readError code, int systemError,
+    const char* message);
+const char* readErrorName(readError code);
+
+int readHeader(pnmHeader* header, FILE* inputFd, readContext* ctx);
+// Decodes the body into dst, which must be exactly the size of the image but
+// may be a view into a larger buffer.
+int readBody(const pnmHeader* header, const imageView* dst, FILE* inputFd,
+    readContext* ctx);
+
+// Decodes dst->height rows starting at firstRow into dst, which must be as
+// wide as the image. The input must already be at the start of firstRow:
+// right after the header for row 0, at rawRowSize bytes per row past that for
+// P5/P6, or at an offset taken from a rowIndex for P2/P3.
+int readRows(const pnmHeader* header, size_t firstRow, const imageView* dst,
+    FILE* inputFd, readContext* ctx);
+
+int readHeaderSpan(pnmHeader* header, byteSpan* input, readContext* ctx);
+int readBodySpan(const pnmHeader* header, const imageView* dst, byteSpan* input,
+    readContext* ctx);
+int readRowsSpan(const pnmHeader* header, size_t firstRow, const imageView* dst,
+    byteSpan* input, readContext* ctx);
+// Points a view straight into the span instead of copying, which is possible
+// for 8-bit P6 bodies. Any other body fails with READ_ERROR_UNSUPPORTED, and
+// the caller should fall back to readBodySpan. The view lives only as long as
+// the span's data, and may only be written through if that data is writable.
+int viewBodySpan(const pnmHeader* header, imageView* view, byteSpan* input,
+    readContext* ctx);
+
+// Bytes per row of a P5/P6 body, or 0 for the ASCII formats, whose rows vary.
+size_t rawRowSize(const pnmHeader* header);
 
 #endif // CS430_PNM_READ_H
@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "region.h"
+#include "source.h"
+#include "view.h"
+
+int decodeRegion(const pnmHeader* header, long long bodyOffset,
+    const rowIndex* index, size_t x, size_t y, const imageView* dst,
+    readSource* src, readContext* ctx);
+int decodeRawRegion(const pnmHeader* header, long long bodyOffset, size_t x,
+    size_t y, const imageView* dst, readSource* src, readContext* ctx);
+int decodeAsciiRegion(const pnmHeader* header, long long bodyOffset,
+    const rowIndex* index, size_t x, size_t y, const imageView* dst,
+    readSource* src, readContext* ctx);
+
+int readRegion(const pnmHeader* header, long long bodyOffset,
+        const rowIndex* index, size_t x, size_t y, const imageView* dst,
+        FILE* inputFd, readContext* ctx) {
+    readSource src = { inputFd, NULL, 0 };
+
+    return decodeRegion(header, bodyOffset, index, x, y, dst, &src, ctx);
+}
+
+int readRegionSpan(const pnmHeader* header, long long bodyOffset,
+        const rowIndex* index, size_t x, size_t y, const imageView* dst,
+        byteSpan* input, readContext* ctx) {
+    readSource src = { NULL, input, 0 };
+
+    return decodeRegion(header, bodyOffset, index, x, y, dst, &src, ctx);
+}
+
+int decodeRegion(const pnmHeader* header, long long bodyOffset,
+        const rowIndex* index, size_t x, size_t y, const imageView* dst,
+        readSource* src, readContext* ctx) {
+    if(x > header->width || dst->width > header->width - x ||
+            y > header->height || dst->height > header->height - y) {
+        return readFail(ctx, src, READ_ERROR_RANGE,
+            "Region %zux%zu at (%zu, %zu) lies outside the %zux%zu image",
+            dst->width, dst->height, x, y, header->width, header->height);
+    }
+
+    if(dst->width == 0 || dst->height == 0) {
+        return 0;
+    }
+
+    if(rawRowSize(header) != 0) {
+        return decodeRawRegion(header, bodyOffset, x, y, dst, src, ctx);
+    }
+
+    return decodeAsciiRegion(header, bodyOffset, index, x, y, dst, src, ctx);
+}
+
+int decodeRawRegion(const pnmHeader* header, long long bodyOffset, size_t x,
+        size_t y, const imageView* dst, readSource* src, readContext* ctx) {
+    size_t rowSize = rawRowSize(header);
+    size_t pixelSize = rowSize / header->width;
+    size_t spanSize = dst->width * pixelSize;
+    // 8-bit RGB needs no conversion and is read straight into place
+    int direct = pixelSize == sizeof(pixel) && header->mode == 6;
+    unsigned char* samples = NULL;
+
+    if(!direct && (samples = malloc(spanSize)) == NULL) {
+        return readFail(ctx, src, READ_ERROR_MEMORY,
+            "Memory allocation error on row buffer");
+    }
+
+    for(size_t i = 0; i < dst->height; i++) {
+        long long offset = bodyOffset + (long long)((y + i) * rowSize + x * pixelSize);
+        pixel* out = viewRow(dst, i);
+
+        if(sourceSeek(src, offset) < 0) {
+            free(samples);
+            return readFail(ctx, src, READ_ERROR_IO, "Cannot seek to row %zu", y + i);
+        }
+
+        if(sourceRead(src, direct ? (void*)out : (void*)samples, spanSize) != spanSize) {
+            free(samples);
+            return readFailStream(ctx, src, "pixel data");
+        }
+
+        if(!direct) {
+            convertRawPixels(header, samples, out, dst->width);
+        }
+    }
+
+    free(samples);
+
+    return 0;
+}
+
+int decodeAsciiRegion(const pnmHeader* header, long long bodyOffset,
+        const rowIndex* index, size_t x, size_t y, const imageView* dst,
+        readSource* src, readContext* ctx) {
+    size_t row = 0;
+    long long offset = bodyOffset;
+    pixel* scratch;
+    imageView line;
+
+    if(index != NULL && (index->width != header->width ||
+            index->height != header->height ||
+            rowIndexLocate(index, y, &row, &offset) < 0)) {
+        return readFail(ctx, src, READ_ERROR_RANGE,
+            "Row index does not match the image");
+    }
+
+    if(sourceSeek(src, offset) < 0) {
+        return readFail(ctx, src, READ_ERROR_IO, "Cannot seek to row %zu", row);
+    }
+
+    // Columns have no fixed offsets, so each row is parsed whole into a
+    // single-row buffer and only the covered columns are kept.
+    if((scratch = malloc(sizeof(*scratch) * header->width)) == NULL) {
+        return readFail(ctx, src, READ_ERROR_MEMORY,
+            "Memory allocation error on row buffer");
+    }
+    line = viewMake(scratch, header->width, 1, header->width);
+
+    for(; row < y + dst->height; row++) {
+        if(parseRows(header, row, &line, src, ctx) < 0) {
+            free(scratch);
+            return -1;
+        }
+
+        if(row >= y) {
+            memcpy(viewRow(dst, row - y), scratch + x, sizeof(*scratch) * dst->width);
+        }
+    }
+
+    free(scratch);
+
+    return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef CS430_REGION_H
+#define CS430_REGION_H
+
+#include <stdio.h>
+
+#include "pnm.h"
+#include "read.h"
+#include "rowindex.h"
+
+// Decodes only the dst->width x dst->height rectangle at (x, y) into dst.
+// bodyOffset is where the pixel data starts, i.e. the input offset right
+// after readHeader. P5/P6 rows are seeked to directly and only the covered
+// columns are read. P2/P3 rows are parsed from the closest indexed row above
+// the rectangle, or from the start of the body without an index, and stop at
+// its last row.
+int readRegion(const pnmHeader* header, long long bodyOffset,
+    const rowIndex* index, size_t x, size_t y, const imageView* dst,
+    FILE* inputFd, readContext* ctx);
+int readRegionSpan(const pnmHeader* header, long long bodyOffset,
+    const rowIndex* index, size_t x, size_t y, const imageView* dst,
+    byteSpan* input, readContext* ctx);
+
+#endif // CS430_REGION_H
@@ -0,0 +1,300 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "rowindex.h"
+#include "source.h"
+#include "varint.h"
+
+#define CS430_ROWINDEX_MAGIC "PNMRIDX1"
+#define CS430_ROWINDEX_MAGIC_SIZE 8
+
+typedef struct rowIndexJob {
+    const rowIndex* index;
+    const pnmHeader* header;
+    const byteSpan* input;
+    const imageView* dst;
+    size_t entry;
+    readContext ctx;
+} rowIndexJob;
+
+int buildIndex(rowIndex* index, const pnmHeader* header, size_t interval,
+    readSource* src, readContext* ctx);
+void rowIndexTask(void* arg);
+
+int rowIndexBuild(rowIndex* index, const pnmHeader* header, size_t interval,
+        FILE* inputFd, readContext* ctx) {
+    readSource src = { inputFd, NULL, 0 };
+
+    return buildIndex(index, header, interval, &src, ctx);
+}
+
+int rowIndexBuildSpan(rowIndex* index, const pnmHeader* header, size_t interval,
+        byteSpan* input, readContext* ctx) {
+    readSource src = { NULL, input, 0 };
+
+    return buildIndex(index, header, interval, &src, ctx);
+}
+
+int buildIndex(rowIndex* index, const pnmHeader* header, size_t interval,
+        readSource* src, readContext* ctx) {
+    size_t channels, samplesPerRow, row = 0, column = 0;
+    int value;
+
+    memset(index, 0, sizeof(*index));
+
+    if(header->mode == 2) {
+        channels = 1;
+    }
+    else if(header->mode == 3) {
+        channels = 3;
+    }
+    else {
+        return readFail(ctx, src, READ_ERROR_UNSUPPORTED,
+            "P%d rows are fixed size and need no index", header->mode);
+    }
+
+    if(interval == 0) {
+        interval = 1;
+    }
+
+    index->width = header->width;
+    index->height = header->height;
+    index->interval = interval;
+    index->count = (header->height + interval - 1) / interval;
+
+    if((index->offsets = malloc(sizeof(*index->offsets) * index->count)) == NULL) {
+        return readFail(ctx, src, READ_ERROR_MEMORY,
+            "Memory allocation error on row index");
+    }
+
+    samplesPerRow = header->width * channels;
+
+    // Walk the body one sample at a time: a run of digits, then whitespace.
+    // The first sample of every interval-th row has its offset recorded.
+    while(row < header->height) {
+        if(column == 0 && row % interval == 0) {
+            index->offsets[row / interval] = sourceOffset(src);
+        }
+
+        if((value = sourceGet(src)) == EOF || !isdigit(value)) {
+            rowIndexFree(index);
+            if(value == EOF) {
+                return readFailStream(ctx, src, "row index");
+            }
+            return readFail(ctx, src, READ_ERROR_FORMAT,
+                "Invalid decimal value on channel");
+        }
+
+        while((value = sourceGet(src)) != EOF && isdigit(value));
+
+        if(++column == samplesPerRow) {
+            column = 0;
+            row++;
+        }
+
+        // The very last sample may end the input, anything earlier may not
+        if(value == EOF) {
+            if(row < header->height || sourceError(src)) {
+                rowIndexFree(index);
+                return readFailStream(ctx, src, "row index");
+            }
+            break;
+        }
+
+        if(!isspace(value)) {
+            rowIndexFree(index);
+            return readFail(ctx, src, READ_ERROR_FORMAT,
+                "There must be at least one whitespace character inbetween "
+                "pixel data");
+        }
+
+        if(row == header->height) {
+            break;
+        }
+
+        while((value = sourceGet(src)) != EOF && isspace(value));
+
+        if(value == EOF || sourceUnget(src, value) == EOF) {
+            rowIndexFree(index);
+            return readFailStream(ctx, src, "row index");
+        }
+    }
+
+    return 0;
+}
+
+void rowIndexFree(rowIndex* index) {
+    free(index->offsets);
+    memset(index, 0, sizeof(*index));
+}
+
+int rowIndexLocate(const rowIndex* index, size_t row, size_t* indexedRow,
+        long long* offset) {
+    if(row >= index->height) {
+        return -1;
+    }
+
+    *indexedRow = row - row % index->interval;
+    *offset = index->offsets[row / index->interval];
+
+    return 0;
+}
+
+int rowIndexSave(const rowIndex* index, const char* path) {
+    FILE* outputFd;
+    long long previous = 0;
+    int status = 0;
+
+    if((outputFd = fopen(path, "wb")) == NULL) {
+        return -1;
+    }
+
+    if(fwrite(CS430_ROWINDEX_MAGIC, 1, CS430_ROWINDEX_MAGIC_SIZE, outputFd) !=
+            CS430_ROWINDEX_MAGIC_SIZE ||
+            writeVarint(index->width, outputFd) < 0 ||
+            writeVarint(index->height, outputFd) < 0 ||
+            writeVarint(index->interval, outputFd) < 0) {
+        status = -1;
+    }
+
+    // Offsets only ever increase, so the deltas stay small
+    for(size_t i = 0; status == 0 && i < index->count; i++) {
+        status = writeVarint(index->offsets[i] - previous, outputFd);
+        previous = index->offsets[i];
+    }
+
+    if(fclose(outputFd) == EOF) {
+        return -1;
+    }
+
+    return status;
+}
+
+int rowIndexLoad(rowIndex* index, const pnmHeader* header, long long inputLength,
+        const char* path, readContext* ctx) {
+    FILE* inputFd;
+    char magic[CS430_ROWINDEX_MAGIC_SIZE];
+    unsigned long long width, height, interval, count, delta;
+    long long offset = 0;
+
+    memset(index, 0, sizeof(*index));
+
+    if((inputFd = fopen(path, "rb")) == NULL) {
+        return readContextFail(ctx, READ_ERROR_IO, errno, "Cannot open row index");
+    }
+
+    if(fread(magic, 1, sizeof(magic), inputFd) != sizeof(magic) ||
+            memcmp(magic, CS430_ROWINDEX_MAGIC, sizeof(magic)) != 0 ||
+            readVarint(&width, inputFd) < 0 || readVarint(&height, inputFd) < 0 ||
+            readVarint(&interval, inputFd) < 0 ||
+            width != header->width || height != header->height) {
+        fclose(inputFd);
+        return readContextFail(ctx, READ_ERROR_FORMAT, 0,
+            "Row index does not match the image");
+    }
+
+    // An interval past the height would leave no entries at all, and the
+    // count must fit in size_t on 32-bit builds too
+    count = interval == 0 || interval > height ? 0 : (height - 1) / interval + 1;
+    if(count == 0 || count > SIZE_MAX / sizeof(*index->offsets)) {
+        fclose(inputFd);
+        return readContextFail(ctx, READ_ERROR_FORMAT, 0,
+            "Row index interval is out of range");
+    }
+
+    index->width = (size_t)width;
+    index->height = (size_t)height;
+    index->interval = (size_t)interval;
+    index->count = (size_t)count;
+
+    if((index->offsets = malloc(sizeof(*index->offsets) * index->count)) == NULL) {
+        fclose(inputFd);
+        return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on row index");
+    }
+
+    // Deltas are unsigned, so offsets cannot go backwards; each row must
+    // still start inside the input
+    for(size_t i = 0; i < index->count; i++) {
+        if(readVarint(&delta, inputFd) < 0 ||
+                delta >= (unsigned long long)(inputLength - offset)) {
+            rowIndexFree(index);
+            fclose(inputFd);
+            return readContextFail(ctx, READ_ERROR_FORMAT, 0,
+                "Row index offset is out of range");
+        }
+
+        offset += (long long)delta;
+        index->offsets[i] = offset;
+    }
+
+    fclose(inputFd);
+
+    return 0;
+}
+
+int rowIndexDecodeSpan(threadPool* pool, const rowIndex* index,
+        const pnmHeader* header, const byteSpan* input, const imageView* dst,
+        readContext* ctx) {
+    rowIndexJob* jobs;
+    poolGroup group;
+    int status = 0;
+
+    if(dst->width != header->width || dst->height != header->height ||
+            index->width != header->width || index->height != header->height) {
+        return readContextFail(ctx, READ_ERROR_RANGE, 0,
+            "Row index or destination does not match the image");
+    }
+
+    if((jobs = malloc(sizeof(*jobs) * index->count)) == NULL) {
+        return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on decode jobs");
+    }
+
+    poolGroupInit(&group);
+    for(size_t i = 0; i < index->count; i++) {
+        jobs[i].index = index;
+        jobs[i].header = header;
+        jobs[i].input = input;
+        jobs[i].dst = dst;
+        jobs[i].entry = i;
+        readContextInit(&jobs[i].ctx);
+
+        if(poolSubmit(pool, &group, rowIndexTask, &jobs[i]) < 0) {
+            rowIndexTask(&jobs[i]);
+        }
+    }
+    poolWait(pool, &group);
+
+    // Report the earliest failure in the image, as a serial decode would
+    for(size_t i = 0; i < index->count; i++) {
+        if(jobs[i].ctx.code != READ_OK) {
+            *ctx = jobs[i].ctx;
+            status = -1;
+            break;
+        }
+    }
+
+    free(jobs);
+
+    return status;
+}
+
+void rowIndexTask(void* arg) {
+    rowIndexJob* job = arg;
+    size_t firstRow = job->entry * job->index->interval;
+    size_t rows = job->index->height - firstRow < job->index->interval ?
+        job->index->height - firstRow : job->index->interval;
+    // Each task gets its own cursor over the shared bytes
+    byteSpan span = *job->input;
+    imageView band = *job->dst;
+
+    span.offset = (size_t)job->index->offsets[job->entry];
+    band.pixels += firstRow * band.stride;
+    band.height = rows;
+
+    readRowsSpan(job->header, firstRow, &band, &span, &job->ctx);
+}
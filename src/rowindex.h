@@ -0,0 +1,49 @@
+#ifndef CS430_ROWINDEX_H
+#define CS430_ROWINDEX_H
+
+#include <stdio.h>
+
+#include "pnm.h"
+#include "pool.h"
+#include "read.h"
+
+// Byte offsets of every interval-th row of an ASCII (P2/P3) body, whose rows
+// otherwise can only be found by parsing everything before them. Offsets are
+// absolute within the input: the file, or the span the index was built from.
+typedef struct rowIndex {
+    size_t width;
+    size_t height;
+    size_t interval;
+    size_t count;
+    long long* offsets;
+} rowIndex;
+
+// Scans a body, positioned right after its header, recording where every
+// interval-th row starts (1 indexes every row). The input is left at the end
+// of the body. Only the sample boundaries are checked; the values themselves
+// are validated by whichever decode later uses the index.
+int rowIndexBuild(rowIndex* index, const pnmHeader* header, size_t interval,
+    FILE* inputFd, readContext* ctx);
+int rowIndexBuildSpan(rowIndex* index, const pnmHeader* header, size_t interval,
+    byteSpan* input, readContext* ctx);
+void rowIndexFree(rowIndex* index);
+
+// Finds the closest indexed row at or above row, returning it and its offset.
+// Decoding from there reaches row after at most interval - 1 rows.
+int rowIndexLocate(const rowIndex* index, size_t row, size_t* indexedRow,
+    long long* offset);
+
+// The sidecar stores the offsets as varint deltas, a few bytes per entry.
+int rowIndexSave(const rowIndex* index, const char* path);
+// Fails if the sidecar is damaged or was built for different dimensions, or
+// if an offset falls outside the inputLength bytes of input it indexes.
+int rowIndexLoad(rowIndex* index, const pnmHeader* header, long long inputLength,
+    const char* path, readContext* ctx);
+
+// Decodes a whole ASCII body held in memory on the pool, one task per indexed
+// stretch of rows, each parsing from its own offset into dst.
+int rowIndexDecodeSpan(threadPool* pool, const rowIndex* index,
+    const pnmHeader* header, const byteSpan* input, const imageView* dst,
+    readContext* ctx);
+
+#endif // CS430_ROWINDEX_H
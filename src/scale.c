@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "scale.h"
+#include "source.h"
+#include "thread.h"
+#include "view.h"
+
+int decodeScaled(const pnmHeader* header, size_t factor, const imageView* dst,
+    readSource* src, readContext* ctx);
+void scaleAccumulate(const pixel* in, size_t width, size_t factor,
+    unsigned long* sums);
+void scaleResolve(unsigned long* sums, size_t width, size_t factor, size_t rows,
+    pixel* out);
+
+size_t scaledSize(size_t size, size_t factor) {
+    return (size + factor - 1) / factor;
+}
+
+size_t scaleFactorToFit(const pnmHeader* header, size_t maxWidth, size_t maxHeight) {
+    size_t factor = 1;
+
+    while(scaledSize(header->width, factor) > maxWidth ||
+            scaledSize(header->height, factor) > maxHeight) {
+        factor *= 2;
+    }
+
+    return factor;
+}
+
+int readScaled(const pnmHeader* header, size_t factor, const imageView* dst,
+        FILE* inputFd, readContext* ctx) {
+    readSource src = { inputFd, NULL, 0 };
+
+    return decodeScaled(header, factor, dst, &src, ctx);
+}
+
+int readScaledSpan(const pnmHeader* header, size_t factor, const imageView* dst,
+        byteSpan* input, readContext* ctx) {
+    readSource src = { NULL, input, 0 };
+
+    return decodeScaled(header, factor, dst, &src, ctx);
+}
+
+int readSampled(const pnmHeader* header, size_t factor, const imageView* dst,
+        FILE* inputFd, volatile long* cancel, readContext* ctx) {
+    readSource src = { inputFd, NULL, 0 };
+    size_t rowSize = rawRowSize(header);
+    long long body = sourceOffset(&src);
+    pixel* row;
+    unsigned long* sums;
+
+    if(factor == 0 || dst->width != scaledSize(header->width, factor) ||
+            dst->height != scaledSize(header->height, factor)) {
+        return readFail(ctx, &src, READ_ERROR_RANGE,
+            "Destination is %zux%zu but the image scaled by %zu is %zux%zu",
+            dst->width, dst->height, factor, scaledSize(header->width, factor),
+            scaledSize(header->height, factor));
+    }
+    if(rowSize == 0 || body < 0) {
+        return readFail(ctx, &src, READ_ERROR_UNSUPPORTED,
+            "P%d rows cannot be seeked to", header->mode);
+    }
+
+    if((row = malloc(sizeof(*row) * header->width)) == NULL ||
+            (sums = calloc(3 * dst->width, sizeof(*sums))) == NULL) {
+        free(row);
+        return readFail(ctx, &src, READ_ERROR_MEMORY,
+            "Memory allocation error on sample buffers");
+    }
+
+    for(size_t i = 0; i < dst->height; i++) {
+        size_t rows = header->height - i * factor < factor ?
+            header->height - i * factor : factor;
+        // The middle row of the block stands in for all of it
+        size_t sample = i * factor + rows / 2;
+        imageView rowView = viewMake(row, header->width, 1, header->width);
+
+        if(cancel != NULL && atomicLoad(cancel)) {
+            free(sums);
+            free(row);
+            return readContextFail(ctx, READ_ERROR_IO, ECANCELED,
+                "Read cancelled");
+        }
+        if(sourceSeek(&src, body + (long long)(rowSize * sample)) < 0) {
+            free(sums);
+            free(row);
+            return readFail(ctx, &src, READ_ERROR_IO, "Cannot seek to row %zu",
+                sample);
+        }
+        if(parseRows(header, sample, &rowView, &src, ctx) < 0) {
+            free(sums);
+            free(row);
+            return -1;
+        }
+
+        scaleAccumulate(row, header->width, factor, sums);
+        scaleResolve(sums, header->width, factor, 1, viewRow(dst, i));
+    }
+
+    free(sums);
+    free(row);
+
+    // Back where it started, so the body can still be read in full
+    if(sourceSeek(&src, body) < 0) {
+        return readFail(ctx, &src, READ_ERROR_IO, "Cannot seek to the body");
+    }
+
+    return 0;
+}
+
+int scaleFilterInit(scaleFilter* filter, const pnmHeader* header, size_t factor) {
+    filter->width = header->width;
+    filter->height = header->height;
+    filter->factor = factor;
+    filter->row = 0;
+
+    if((filter->sums = calloc(3 * scaledSize(header->width, factor),
+            sizeof(*filter->sums))) == NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
+size_t scaleFilterPush(scaleFilter* filter, const imageView* band, pixel* out) {
+    size_t outWidth = scaledSize(filter->width, filter->factor);
+    size_t produced = 0;
+
+    for(size_t r = 0; r < band->height; r++) {
+        size_t blockRows;
+
+        scaleAccumulate(viewRow(band, r), filter->width, filter->factor,
+            filter->sums);
+        filter->row++;
+
+        // A block ends every factor rows, or early at the bottom edge
+        blockRows = filter->row % filter->factor == 0 ? filter->factor :
+            filter->row == filter->height ? filter->row % filter->factor : 0;
+        if(blockRows != 0) {
+            scaleResolve(filter->sums, filter->width, filter->factor, blockRows,
+                out + produced * outWidth);
+            produced++;
+        }
+    }
+
+    return produced;
+}
+
+void scaleFilterFree(scaleFilter* filter) {
+    free(filter->sums);
+    memset(filter, 0, sizeof(*filter));
+}
+
+int decodeScaled(const pnmHeader* header, size_t factor, const imageView* dst,
+        readSource* src, readContext* ctx) {
+    pixel* band;
+    unsigned long* sums;
+
+    if(factor == 0 || dst->width != scaledSize(header->width, factor) ||
+            dst->height != scaledSize(header->height, factor)) {
+        return readFail(ctx, src, READ_ERROR_RANGE,
+            "Destination is %zux%zu but the image scaled by %zu is %zux%zu",
+            dst->width, dst->height, factor, scaledSize(header->width, factor),
+            scaledSize(header->height, factor));
+    }
+
+    if(factor == 1) {
+        return parseRows(header, 0, dst, src, ctx);
+    }
+
+    if((band = malloc(sizeof(*band) * header->width * factor)) == NULL ||
+            (sums = calloc(3 * dst->width, sizeof(*sums))) == NULL) {
+        free(band);
+        return readFail(ctx, src, READ_ERROR_MEMORY,
+            "Memory allocation error on scale buffers");
+    }
+
+    for(size_t i = 0; i < dst->height; i++) {
+        size_t rows = header->height - i * factor < factor ?
+            header->height - i * factor : factor;
+        imageView bandView = viewMake(band, header->width, rows, header->width);
+
+        if(parseRows(header, i * factor, &bandView, src, ctx) < 0) {
+            free(sums);
+            free(band);
+            return -1;
+        }
+
+        // Sum each factor x factor block, a source row at a time
+        for(size_t r = 0; r < rows; r++) {
+            scaleAccumulate(band + r * header->width, header->width, factor, sums);
+        }
+        scaleResolve(sums, header->width, factor, rows, viewRow(dst, i));
+    }
+
+    free(sums);
+    free(band);
+
+    return 0;
+}
+
+void scaleAccumulate(const pixel* in, size_t width, size_t factor,
+        unsigned long* sums) {
+    size_t outWidth = scaledSize(width, factor);
+
+    for(size_t j = 0; j < outWidth; j++) {
+        size_t end = (j + 1) * factor < width ? (j + 1) * factor : width;
+
+        for(size_t k = j * factor; k < end; k++) {
+            sums[j * 3] += in[k].red;
+            sums[j * 3 + 1] += in[k].green;
+            sums[j * 3 + 2] += in[k].blue;
+        }
+    }
+}
+
+void scaleResolve(unsigned long* sums, size_t width, size_t factor, size_t rows,
+        pixel* out) {
+    size_t outWidth = scaledSize(width, factor);
+
+    for(size_t j = 0; j < outWidth; j++) {
+        size_t columns = width - j * factor < factor ? width - j * factor : factor;
+        unsigned long count = (unsigned long)(columns * rows);
+
+        // Round to nearest rather than truncate
+        out[j].red = (unsigned char)((sums[j * 3] + count / 2) / count);
+        out[j].green = (unsigned char)((sums[j * 3 + 1] + count / 2) / count);
+        out[j].blue = (unsigned char)((sums[j * 3 + 2] + count / 2) / count);
+    }
+
+    memset(sums, 0, sizeof(*sums) * 3 * outWidth);
+}
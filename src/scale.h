@@ -0,0 +1,53 @@
+#ifndef CS430_SCALE_H
+#define CS430_SCALE_H
+
+#include <stdio.h>
+
+#include "pnm.h"
+#include "read.h"
+
+// Box-filters rows as they stream past, for a reduced copy built alongside a
+// full resolution decode without reading the body again.
+typedef struct scaleFilter {
+    size_t width;
+    size_t height;
+    size_t factor;
+    // Source rows pushed so far
+    size_t row;
+    unsigned long* sums;
+} scaleFilter;
+
+// Size of an image reduced by factor, rounding up so that partial blocks at
+// the right and bottom edges still produce a pixel.
+size_t scaledSize(size_t size, size_t factor);
+// The smallest power of two that shrinks the image to fit within
+// maxWidth x maxHeight, or 1 if it already fits.
+size_t scaleFactorToFit(const pnmHeader* header, size_t maxWidth, size_t maxHeight);
+
+// Decodes the body, positioned right after the header, reduced by factor in
+// both directions with a box filter applied during decode. Only factor rows
+// of full resolution pixels are held at a time, never the full raster. dst
+// must be scaledSize(width) x scaledSize(height).
+int readScaled(const pnmHeader* header, size_t factor, const imageView* dst,
+    FILE* inputFd, readContext* ctx);
+int readScaledSpan(const pnmHeader* header, size_t factor, const imageView* dst,
+    byteSpan* input, readContext* ctx);
+
+// Reduces a raw (P5/P6) body by factor, reading only the middle row of each
+// block of factor rows, with a seek to each, and averaging across the block
+// in that row. A fraction of the body is read, so it is much faster than
+// readScaled at some cost in quality. The stream must be right after the
+// header, and is left there. cancel, if not NULL, is polled before each row;
+// once it is set the read stops and fails with ECANCELED.
+int readSampled(const pnmHeader* header, size_t factor, const imageView* dst,
+    FILE* inputFd, volatile long* cancel, readContext* ctx);
+
+// Prepares to reduce header's image by factor as its rows arrive.
+int scaleFilterInit(scaleFilter* filter, const pnmHeader* header, size_t factor);
+// Takes the band's rows, which must follow on from the last band's, and writes
+// every reduced row they complete to out, returning how many. The last block
+// is completed by the image's last row even if it is short.
+size_t scaleFilterPush(scaleFilter* filter, const imageView* band, pixel* out);
+void scaleFilterFree(scaleFilter* filter);
+
+#endif // CS430_SCALE_H
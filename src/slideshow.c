@@ -0,0 +1,267 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "slideshow.h"
+#include "thread.h"
+#include "trace.h"
+#include "view.h"
+
+size_t slideshowRange(const slideshow* show);
+size_t slideshowRank(const slideshow* show, size_t index);
+size_t slideshowAtRank(const slideshow* show, size_t rank);
+void slideDecodeTask(void* arg);
+void slideLoad(slideshow* show, slide* target);
+int slideBeginUpload(slideshow* show, slide* target);
+int slideUploadBand(slide* target, uploadBudget* uploads);
+void slideRelease(slide* target);
+
+int slideshowOpen(slideshow* show, const char* const* paths, size_t count,
+        size_t prefetch, size_t budget, threadPool* decodePool, threadPool* mipPool,
+        texturePool* texturePool, slideshowNotifyFn notify, void* notifyArg) {
+    memset(show, 0, sizeof(*show));
+
+    if(count == 0 || (show->slides = calloc(count, sizeof(*show->slides))) == NULL) {
+        return -1;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        show->slides[i].show = show;
+        show->slides[i].path = paths[i];
+        show->slides[i].state = SLIDE_EMPTY;
+        imageInit(&show->slides[i].img);
+        readContextInit(&show->slides[i].ctx);
+    }
+
+    show->count = count;
+    show->prefetch = prefetch;
+    show->budget = budget;
+    show->decodePool = decodePool;
+    show->mipPool = mipPool;
+    show->texturePool = texturePool;
+    show->notify = notify;
+    show->notifyArg = notifyArg;
+    poolGroupInit(&show->group);
+
+    return 0;
+}
+
+void slideshowStep(slideshow* show, long step) {
+    long offset = step % (long)show->count;
+
+    if(offset < 0) {
+        offset += (long)show->count;
+    }
+
+    show->current = (show->current + (size_t)offset) % show->count;
+}
+
+int slideshowUpdate(slideshow* show, uploadBudget* uploads, const slide** failed) {
+    const slide* current = &show->slides[show->current];
+    size_t range = slideshowRange(show);
+    size_t used = 0;
+    int changed = 0;
+
+    *failed = NULL;
+
+    // Out of range slides go first, so their memory is back before more of
+    // the range is loaded
+    for(size_t i = 0; i < show->count; i++) {
+        if(slideshowRank(show, i) >= range) {
+            slideRelease(&show->slides[i]);
+        }
+    }
+
+    for(size_t rank = 0; rank < range; rank++) {
+        slide* next = &show->slides[slideshowAtRank(show, rank)];
+        // Frames of a sequence are usually all the same size
+        size_t bytes = next->bytes != 0 ? next->bytes : current->bytes;
+
+        // Until the current slide's size is known, neighbours cannot be
+        // budgeted for, and would only slow it down
+        if(rank > 0 && current->state == SLIDE_LOADING && bytes == 0) {
+            break;
+        }
+
+        if(rank > 0 && used + bytes > show->budget) {
+            slideRelease(next);
+            continue;
+        }
+        used += bytes;
+
+        if(next->state == SLIDE_EMPTY) {
+            slideLoad(show, next);
+        }
+
+        if(*failed == NULL && next->state == SLIDE_LOADING &&
+                atomicLoad(&next->decoded) != 0) {
+            if(slideBeginUpload(show, next) < 0) {
+                *failed = next;
+            }
+            changed = 1;
+        }
+
+        while(*failed == NULL && next->state == SLIDE_UPLOADING &&
+                uploadBudgetAvailable(uploads)) {
+            if(slideUploadBand(next, uploads) < 0) {
+                *failed = next;
+            }
+            changed = 1;
+        }
+    }
+
+    return changed;
+}
+
+const textureGrid* slideshowCurrent(const slideshow* show, size_t* filledRows) {
+    const slide* current = &show->slides[show->current];
+
+    if(current->state != SLIDE_UPLOADING && current->state != SLIDE_READY) {
+        return NULL;
+    }
+
+    *filledRows = current->uploadedRows;
+    return &current->grid;
+}
+
+void slideshowClose(slideshow* show) {
+    if(show->slides == NULL) {
+        return;
+    }
+
+    if(show->decodePool != NULL) {
+        poolWait(show->decodePool, &show->group);
+    }
+
+    for(size_t i = 0; i < show->count; i++) {
+        slideRelease(&show->slides[i]);
+    }
+    free(show->slides);
+
+    memset(show, 0, sizeof(*show));
+}
+
+size_t slideshowRange(const slideshow* show) {
+    size_t range = 2 * show->prefetch + 1;
+
+    return range < show->count ? range : show->count;
+}
+
+// Rank 0 is the current slide, then one forward, one back, two forward...
+// Ranks below slideshowRange name distinct slides.
+size_t slideshowRank(const slideshow* show, size_t index) {
+    size_t forward = (index + show->count - show->current) % show->count;
+    size_t back = (show->current + show->count - index) % show->count;
+
+    return forward <= back ? (forward == 0 ? 0 : 2 * forward - 1) : 2 * back;
+}
+
+size_t slideshowAtRank(const slideshow* show, size_t rank) {
+    size_t distance = (rank + 1) / 2 % show->count;
+
+    return rank % 2 == 1 ? (show->current + distance) % show->count :
+        (show->current + show->count - distance) % show->count;
+}
+
+void slideDecodeTask(void* arg) {
+    slide* target = arg;
+    slideshow* show = target->show;
+    double start = traceBegin();
+
+    atomicStore(&target->decoded,
+        imageLoad(&target->img, target->path, &target->ctx) < 0 ? -1 : 1);
+    traceEnd("decodeSlide", start);
+
+    if(show->notify != NULL) {
+        show->notify(show->notifyArg);
+    }
+}
+
+void slideLoad(slideshow* show, slide* target) {
+    target->state = SLIDE_LOADING;
+    atomicStore(&target->decoded, 0);
+    readContextInit(&target->ctx);
+
+    if(show->decodePool == NULL || poolSubmit(show->decodePool, &show->group,
+            slideDecodeTask, target) < 0) {
+        slideDecodeTask(target);
+    }
+}
+
+int slideBeginUpload(slideshow* show, slide* target) {
+    if(atomicLoad(&target->decoded) < 0) {
+        target->state = SLIDE_FAILED;
+        return -1;
+    }
+
+    if(textureGridCreate(&target->grid, target->img.header.width,
+            target->img.header.height, 0, show->mipPool, show->texturePool) < 0) {
+        imageFree(&target->img);
+        target->state = SLIDE_FAILED;
+        return readContextFail(&target->ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on textures");
+    }
+
+    // What the padded tiles actually take, not just the image's pixels
+    target->bytes = textureGridBytes(&target->grid);
+    target->uploadedRows = 0;
+    target->state = SLIDE_UPLOADING;
+
+    return 0;
+}
+
+int slideUploadBand(slide* target, uploadBudget* uploads) {
+    size_t width = target->img.header.width;
+    size_t rows = uploadBandRows(width);
+    imageView band;
+    double start;
+
+    if(rows > target->img.header.height - target->uploadedRows) {
+        rows = target->img.header.height - target->uploadedRows;
+    }
+    band = viewMake(target->img.pixels + target->uploadedRows * width, width,
+        rows, width);
+
+    start = clockSeconds();
+    if(textureGridUpload(&target->grid, &band, target->uploadedRows) < 0) {
+        textureGridFree(&target->grid);
+        imageFree(&target->img);
+        target->state = SLIDE_FAILED;
+        return readContextFail(&target->ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on mipmaps");
+    }
+    uploadBudgetCharge(uploads, start, sizeof(pixel) * width * rows);
+
+    target->uploadedRows += rows;
+    if(target->uploadedRows == target->img.header.height) {
+        // The textures hold their own copy now
+        imageFree(&target->img);
+        target->state = SLIDE_READY;
+    }
+
+    return 0;
+}
+
+void slideRelease(slide* target) {
+    switch(target->state) {
+    case SLIDE_LOADING:
+        // Still decoding; released on a later update once it finishes
+        if(atomicLoad(&target->decoded) == 0) {
+            return;
+        }
+        imageFree(&target->img);
+        break;
+    case SLIDE_UPLOADING:
+        textureGridFree(&target->grid);
+        imageFree(&target->img);
+        break;
+    case SLIDE_READY:
+        textureGridFree(&target->grid);
+        break;
+    default:
+        // Failed slides stay failed rather than being retried on every visit
+        return;
+    }
+
+    target->state = SLIDE_EMPTY;
+}
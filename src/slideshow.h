@@ -0,0 +1,93 @@
+#ifndef CS430_SLIDESHOW_H
+#define CS430_SLIDESHOW_H
+
+#include <stddef.h>
+
+#include "image.h"
+#include "pool.h"
+#include "read.h"
+#include "texgrid.h"
+#include "texpool.h"
+#include "upload.h"
+
+// Slides kept loaded on each side of the current one
+#define CS430_SLIDESHOW_PREFETCH 2
+// Texture bytes the current slide and its neighbours may hold together
+#define CS430_SLIDESHOW_BUDGET (512 << 20)
+
+typedef struct slideshow slideshow;
+
+typedef void (*slideshowNotifyFn)(void* arg);
+
+typedef enum slideState {
+    SLIDE_EMPTY,
+    // Queued or decoding on the decode pool
+    SLIDE_LOADING,
+    // Decoded, with its rows going up a band at a time
+    SLIDE_UPLOADING,
+    SLIDE_READY,
+    SLIDE_FAILED
+} slideState;
+
+typedef struct slide {
+    slideshow* show;
+    const char* path;
+    slideState state;
+    // Set by the decode task to 1 once img holds the pixels, or to -1 once
+    // ctx holds the error
+    volatile long decoded;
+    image img;
+    readContext ctx;
+    textureGrid grid;
+    size_t uploadedRows;
+    // Texture bytes, mip levels included, once known. Kept after the slide
+    // is released as an estimate for the next time it loads.
+    size_t bytes;
+} slide;
+
+// Steps through a list of images, keeping the slides around the current one
+// decoded and uploaded so that switching to a neighbour is immediate. Decodes
+// run on their own pool so that the render thread, which builds mip levels
+// on the mip pool and may run queued tasks while it waits, never picks
+// up a whole decode. Uploads happen on the render thread in row bands, as
+// many per update as the upload budget allows, nearest the current slide
+// first. Slides further away are dropped once the
+// budget is spent, though the current slide is always loaded.
+struct slideshow {
+    slide* slides;
+    size_t count;
+    size_t current;
+    size_t prefetch;
+    size_t budget;
+    threadPool* decodePool;
+    threadPool* mipPool;
+    // Frames of a sequence share a size, so a released slide's textures are
+    // refilled by the next one loaded
+    texturePool* texturePool;
+    poolGroup group;
+    // Called on the decode pool as each decode finishes
+    slideshowNotifyFn notify;
+    void* notifyArg;
+};
+
+// paths must outlive the slideshow. Without a decode pool, decodes run on
+// the render thread during slideshowUpdate; mipPool and texturePool may be
+// NULL as for textureGridCreate.
+int slideshowOpen(slideshow* show, const char* const* paths, size_t count,
+    size_t prefetch, size_t budget, threadPool* decodePool, threadPool* mipPool,
+    texturePool* texturePool, slideshowNotifyFn notify, void* notifyArg);
+// Moves step slides forward, or back if negative, wrapping at either end.
+void slideshowStep(slideshow* show, long step);
+// Queues decodes for the slides in range, uploads finished decodes within
+// uploads, which may be NULL, and releases slides out of range or over
+// budget. Needs the GL context. Returns 1 if it uploaded or failed a slide,
+// which may change what is on screen, or 0 otherwise. A slide that failed is
+// pointed to by failed; at most one is reported per update.
+int slideshowUpdate(slideshow* show, uploadBudget* uploads, const slide** failed);
+// The current slide's textures and how many of its rows are in them, or NULL
+// while it is still decoding.
+const textureGrid* slideshowCurrent(const slideshow* show, size_t* filledRows);
+// Waits for outstanding decodes and releases every slide.
+void slideshowClose(slideshow* show);
+
+#endif // CS430_SLIDESHOW_H
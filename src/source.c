@@ -0,0 +1,129 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+
+#include "source.h"
+
+int sourceGet(readSource* src) {
+    if(src->fd != NULL) {
+        return fgetc(src->fd);
+    }
+
+    if(src->span->offset >= src->span->length) {
+        src->eof = 1;
+        return EOF;
+    }
+
+    return src->span->data[src->span->offset++];
+}
+
+int sourceUnget(readSource* src, int value) {
+    if(src->fd != NULL) {
+        return ungetc(value, src->fd);
+    }
+
+    if(value == EOF || src->span->offset == 0) {
+        return EOF;
+    }
+
+    src->span->offset--;
+    src->eof = 0;
+
+    return value;
+}
+
+size_t sourceRead(readSource* src, void* buffer, size_t size) {
+    size_t available;
+
+    if(src->fd != NULL) {
+        return fread(buffer, 1, size, src->fd);
+    }
+
+    available = src->span->length - src->span->offset;
+    if(size > available) {
+        size = available;
+        src->eof = 1;
+    }
+
+    memcpy(buffer, src->span->data + src->span->offset, size);
+    src->span->offset += size;
+
+    return size;
+}
+
+int sourceEof(readSource* src) {
+    if(src->fd != NULL) {
+        return feof(src->fd);
+    }
+
+    return src->eof;
+}
+
+int sourceError(readSource* src) {
+    // Memory cannot fail to read, only run out
+    return src->fd != NULL && ferror(src->fd);
+}
+
+long long sourceOffset(readSource* src) {
+    if(src->fd != NULL) {
+#ifdef _WIN32
+        return _ftelli64(src->fd);
+#else
+        return ftello(src->fd);
+#endif
+    }
+
+    return (long long)src->span->offset;
+}
+
+int sourceSeek(readSource* src, long long offset) {
+    if(src->fd != NULL) {
+#ifdef _WIN32
+        return _fseeki64(src->fd, offset, SEEK_SET) == 0 ? 0 : -1;
+#else
+        return fseeko(src->fd, (off_t)offset, SEEK_SET) == 0 ? 0 : -1;
+#endif
+    }
+
+    if(offset < 0 || (unsigned long long)offset > src->span->length) {
+        return -1;
+    }
+
+    src->span->offset = (size_t)offset;
+    src->eof = 0;
+
+    return 0;
+}
+
+int readFail(readContext* ctx, readSource* src, readError code, const char* format, ...) {
+    va_list args;
+
+    if(ctx->code != READ_OK) {
+        return -1;
+    }
+
+    ctx->code = code;
+    ctx->offset = sourceOffset(src);
+
+    va_start(args, format);
+    vsnprintf(ctx->message, sizeof(ctx->message), format, args);
+    va_end(args);
+
+    return -1;
+}
+
+int readFailStream(readContext* ctx, readSource* src, const char* during) {
+    if(sourceError(src)) {
+        if(ctx->code == READ_OK) {
+            ctx->systemError = errno;
+        }
+
+        return readFail(ctx, src, READ_ERROR_IO, "Read error during %s", during);
+    }
+
+    return readFail(ctx, src, READ_ERROR_EOF, "Premature EOF during %s", during);
+}
@@ -0,0 +1,41 @@
+#ifndef CS430_PNM_SOURCE_H
+#define CS430_PNM_SOURCE_H
+
+#include <stdio.h>
+
+#include "read.h"
+
+// Internal to the readers. Either a stdio stream or an in-memory span, so
+// that one parser serves both.
+typedef struct readSource {
+    FILE* fd;
+    byteSpan* span;
+    // Set once a span read runs past the end, mirroring feof()
+    int eof;
+} readSource;
+
+int sourceGet(readSource* src);
+int sourceUnget(readSource* src, int value);
+size_t sourceRead(readSource* src, void* buffer, size_t size);
+int sourceEof(readSource* src);
+int sourceError(readSource* src);
+long long sourceOffset(readSource* src);
+// Moves to an absolute byte offset, clearing EOF. Offsets are 64-bit so that
+// files past 2 GB can be seeked on every platform.
+int sourceSeek(readSource* src, long long offset);
+
+// readRows over an already constructed source.
+int parseRows(const pnmHeader* header, size_t firstRow, const imageView* dst,
+    readSource* src, readContext* ctx);
+// Converts count raw P5/P6 pixels (samples as stored in the file) to pixels.
+void convertRawPixels(const pnmHeader* header, const unsigned char* samples,
+    pixel* out, size_t count);
+
+// Records the first error seen on this context and returns -1, so that call
+// sites can simply 'return readFail(...)'.
+int readFail(readContext* ctx, readSource* src, readError code, const char* format, ...);
+// Classifies a failed stream read as either a premature EOF or an I/O error,
+// keeping the errno of the latter instead of printing it.
+int readFailStream(readContext* ctx, readSource* src, const char* during);
+
+#endif // CS430_PNM_SOURCE_H
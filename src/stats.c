@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "stats.h"
+
+const frameSample* frameStatsAt(const frameStats* stats, size_t index);
+int frameStatsCompare(const void* a, const void* b);
+
+int frameStatsInit(frameStats* stats, double refresh, int keepAll) {
+    memset(stats, 0, sizeof(*stats));
+
+    stats->origin = clockSeconds();
+    stats->refresh = refresh;
+    stats->keepAll = keepAll;
+
+    if(!keepAll) {
+        if((stats->frames = malloc(sizeof(*stats->frames) * CS430_STATS_WINDOW)) == NULL) {
+            return -1;
+        }
+        stats->capacity = CS430_STATS_WINDOW;
+    }
+
+    return 0;
+}
+
+int frameStatsAdd(frameStats* stats, frameSample* sample) {
+    sample->dropped = 0;
+    // Half a refresh of slack, as swaps land a little either side of vsync
+    if(stats->refresh > 0 && sample->interval > stats->refresh * 1.5) {
+        sample->dropped = (size_t)(sample->interval / stats->refresh + 0.5) - 1;
+    }
+    stats->dropped += sample->dropped;
+
+    if(stats->keepAll && stats->count == stats->capacity) {
+        size_t capacity = stats->capacity == 0 ? 1024 : stats->capacity * 2;
+        frameSample* grown;
+
+        if((grown = realloc(stats->frames, sizeof(*grown) * capacity)) == NULL) {
+            return -1;
+        }
+        stats->frames = grown;
+        stats->capacity = capacity;
+    }
+
+    stats->frames[stats->keepAll ? stats->count : stats->count % CS430_STATS_WINDOW] =
+        *sample;
+    stats->count++;
+
+    return 0;
+}
+
+int frameStatsSummarize(const frameStats* stats, size_t window,
+        frameSummary* summary) {
+    size_t kept = stats->keepAll || stats->count < CS430_STATS_WINDOW ?
+        stats->count : CS430_STATS_WINDOW;
+    size_t count = window < kept ? window : kept;
+    double uploadSeconds = 0;
+    double uploadBytes = 0;
+    double* times;
+
+    memset(summary, 0, sizeof(*summary));
+    if(count == 0) {
+        return 0;
+    }
+
+    if((times = malloc(sizeof(*times) * count)) == NULL) {
+        return -1;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        const frameSample* sample = frameStatsAt(stats, stats->count - count + i);
+
+        times[i] = sample->cpu + sample->swap;
+        summary->dropped += sample->dropped;
+        uploadSeconds += sample->uploadSeconds;
+        uploadBytes += (double)sample->uploadBytes;
+    }
+
+    // Nearest rank, so both are times some frame actually took
+    qsort(times, count, sizeof(*times), frameStatsCompare);
+    summary->frames = count;
+    summary->p50 = times[(count - 1) / 2];
+    summary->p99 = times[(count * 99 + 99) / 100 - 1];
+    summary->uploadRate = uploadSeconds > 0 ? uploadBytes / uploadSeconds : 0;
+
+    free(times);
+    return 0;
+}
+
+int frameStatsWrite(const frameStats* stats, const char* path) {
+    frameSummary summary;
+    FILE* outputFd;
+    size_t first;
+
+    if(frameStatsSummarize(stats, stats->count, &summary) < 0) {
+        return -1;
+    }
+
+    if((outputFd = fopen(path, "w")) == NULL) {
+        return -1;
+    }
+
+    fprintf(outputFd, "{\n  \"refresh_ms\": %.3f,\n", stats->refresh * 1000);
+    if(stats->loaded) {
+        fprintf(outputFd, "  \"load\": { \"open_ms\": %.3f, \"preview_ms\": %.3f, "
+            "\"decode_ms\": %.3f, \"upload_ms\": %.3f, \"total_ms\": %.3f },\n",
+            stats->load.open * 1000, stats->load.preview * 1000,
+            stats->load.decode * 1000, stats->load.upload * 1000,
+            stats->load.total * 1000);
+    }
+    fprintf(outputFd, "  \"summary\": { \"frames\": %zu, \"p50_ms\": %.3f, "
+        "\"p99_ms\": %.3f, \"dropped\": %zu, \"upload_mb_per_s\": %.3f },\n",
+        summary.frames, summary.p50 * 1000, summary.p99 * 1000, summary.dropped,
+        summary.uploadRate / (1024 * 1024));
+
+    fprintf(outputFd, "  \"frames\": [");
+    first = stats->count - summary.frames;
+    for(size_t i = first; i < stats->count; i++) {
+        const frameSample* sample = frameStatsAt(stats, i);
+
+        fprintf(outputFd, "%s\n    { \"start_ms\": %.3f, \"cpu_ms\": %.3f, "
+            "\"swap_ms\": %.3f, \"interval_ms\": %.3f, \"upload_ms\": %.3f, "
+            "\"upload_bytes\": %zu, \"dropped\": %zu }", i > first ? "," : "",
+            (sample->start - stats->origin) * 1000, sample->cpu * 1000,
+            sample->swap * 1000, sample->interval * 1000,
+            sample->uploadSeconds * 1000, sample->uploadBytes, sample->dropped);
+    }
+    fprintf(outputFd, "\n  ]\n}\n");
+
+    if(ferror(outputFd)) {
+        fclose(outputFd);
+        return -1;
+    }
+
+    return fclose(outputFd) == 0 ? 0 : -1;
+}
+
+void frameStatsFree(frameStats* stats) {
+    free(stats->frames);
+
+    memset(stats, 0, sizeof(*stats));
+}
+
+const frameSample* frameStatsAt(const frameStats* stats, size_t index) {
+    return &stats->frames[stats->keepAll ? index : index % CS430_STATS_WINDOW];
+}
+
+int frameStatsCompare(const void* a, const void* b) {
+    double left = *(const double*)a, right = *(const double*)b;
+
+    return (left > right) - (left < right);
+}
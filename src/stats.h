@@ -0,0 +1,79 @@
+#ifndef CS430_STATS_H
+#define CS430_STATS_H
+
+#include <stddef.h>
+
+// Frames the rolling figures are taken over; four seconds at 60 Hz
+#define CS430_STATS_WINDOW 240
+
+// One pass of the render loop that drew or uploaded anything
+typedef struct frameSample {
+    // clockSeconds() when the pass began
+    double start;
+    // Time on the CPU, the swap excluded
+    double cpu;
+    // Time in the buffer swap, which includes waiting for vsync, or 0 if the
+    // pass only uploaded
+    double swap;
+    // Since the previous frame's swap when the two were drawn back to back,
+    // or 0. Only these can miss a refresh.
+    double interval;
+    double uploadSeconds;
+    size_t uploadBytes;
+    // Refreshes missed before this frame, filled in by frameStatsAdd
+    size_t dropped;
+} frameSample;
+
+// Where the time went between starting to load an image and its last row
+// reaching the GPU, in seconds
+typedef struct loadTimes {
+    // Opening the file and reading its header
+    double open;
+    double preview;
+    // Decoding the full image's bands, waits for the render thread excluded
+    double decode;
+    // Uploading on the render thread
+    double upload;
+    double total;
+} loadTimes;
+
+typedef struct frameSummary {
+    size_t frames;
+    // Percentiles of the frame time, CPU and swap together, in seconds
+    double p50;
+    double p99;
+    size_t dropped;
+    // Bytes per second of upload time, or 0 if nothing was uploaded
+    double uploadRate;
+} frameSummary;
+
+// Timings of the render loop. The last CS430_STATS_WINDOW frames are kept in
+// a ring for the rolling figures, or every frame when they are to be written
+// out at the end. Render thread only.
+typedef struct frameStats {
+    double origin;
+    // Seconds between display refreshes
+    double refresh;
+    frameSample* frames;
+    size_t count;
+    size_t capacity;
+    int keepAll;
+    // Over every frame, not just the window
+    size_t dropped;
+    // Filled in once a streamed image has finished loading
+    loadTimes load;
+    int loaded;
+} frameStats;
+
+int frameStatsInit(frameStats* stats, double refresh, int keepAll);
+// Records a frame, counting the refreshes it missed from its interval.
+// Returns -1 if the frame could not be kept.
+int frameStatsAdd(frameStats* stats, frameSample* sample);
+// Summarizes the last window frames, or as many as are kept.
+int frameStatsSummarize(const frameStats* stats, size_t window,
+    frameSummary* summary);
+// Writes the load times, a summary and every kept frame to path as JSON.
+int frameStatsWrite(const frameStats* stats, const char* path);
+void frameStatsFree(frameStats* stats);
+
+#endif // CS430_STATS_H
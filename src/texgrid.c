@@ -0,0 +1,335 @@
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "texgrid.h"
+#include "trace.h"
+#include "view.h"
+
+typedef struct gridVertex {
+    float position[2];
+    float texCoord[2];
+} gridVertex;
+
+typedef struct gridBand {
+    textureGrid* grid;
+    const imageView* band;
+    size_t firstRow;
+    size_t firstTile;
+} gridBand;
+
+size_t nextPowerOfTwo(size_t value);
+void textureGridBuildRange(void* arg, size_t begin, size_t end);
+void textureGridBuildTile(textureGrid* grid, size_t index, const imageView* band,
+    size_t firstRow);
+int textureGridVisible(const textureGrid* grid, mat4x4 mvp, size_t column,
+    size_t row);
+void textureGridTileRect(const textureGrid* grid, size_t column, size_t row,
+    size_t* x, size_t* y, size_t* width, size_t* height);
+
+int textureGridCreate(textureGrid* grid, size_t width, size_t height,
+        size_t tileSize, threadPool* pool, texturePool* texturePool) {
+    size_t tileCount;
+    gridVertex* vertexes;
+
+    memset(grid, 0, sizeof(*grid));
+
+    if(tileSize == 0) {
+        GLint maxSize;
+
+        // Only the right and bottom edge tiles are padded up to a power of
+        // two, rather than the whole image
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        tileSize = (size_t)maxSize < CS430_TEXGRID_TILE_SIZE ?
+            (size_t)maxSize : CS430_TEXGRID_TILE_SIZE;
+    }
+
+    grid->width = width;
+    grid->height = height;
+    grid->tileSize = tileSize;
+    grid->columns = (width + tileSize - 1) / tileSize;
+    grid->rows = (height + tileSize - 1) / tileSize;
+    grid->pool = pool;
+    grid->texturePool = texturePool;
+    tileCount = grid->columns * grid->rows;
+
+    // Zeroed, so that textureGridFree skips tiles a failure never reached
+    if((grid->textures = calloc(tileCount, sizeof(*grid->textures))) == NULL ||
+            (grid->tiles = calloc(tileCount, sizeof(*grid->tiles))) == NULL) {
+        free(grid->textures);
+        grid->textures = NULL;
+        return -1;
+    }
+
+    if((vertexes = malloc(sizeof(*vertexes) * 4 * tileCount)) == NULL) {
+        textureGridFree(grid);
+        return -1;
+    }
+
+    for(size_t i = 0; i < grid->rows; i++) {
+        for(size_t j = 0; j < grid->columns; j++) {
+            size_t index = i * grid->columns + j;
+            gridTile* tile = &grid->tiles[index];
+            size_t x, y, tileWidth, tileHeight;
+            float left, right, top, bottom, texRight, texBottom;
+
+            textureGridTileRect(grid, j, i, &x, &y, &tileWidth, &tileHeight);
+            tile->textureWidth = nextPowerOfTwo(tileWidth);
+            tile->textureHeight = nextPowerOfTwo(tileHeight);
+
+            if(mipChainInit(&tile->chain, tile->textureWidth,
+                    tile->textureHeight) < 0 || (tile->row = malloc(
+                    sizeof(*tile->row) * tile->textureWidth)) == NULL) {
+                free(vertexes);
+                textureGridFree(grid);
+                return -1;
+            }
+
+            grid->textures[index] = texturePoolAcquire(texturePool,
+                (GLsizei)tile->textureWidth, (GLsizei)tile->textureHeight, GL_RGB,
+                (GLint)tile->chain.levelCount);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            // Keeps linear filtering from wrapping around to the opposite edge
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+            // Image row 0 is the top of the square
+            left = -1 + 2.f * x / width;
+            right = -1 + 2.f * (x + tileWidth) / width;
+            top = 1 - 2.f * y / height;
+            bottom = 1 - 2.f * (y + tileHeight) / height;
+            // Only the unpadded part of the texture is shown
+            texRight = (float)tileWidth / tile->textureWidth;
+            texBottom = (float)tileHeight / tile->textureHeight;
+
+            gridVertex quad[4] = {
+                {{right, bottom}, {texRight, texBottom}},
+                {{right, top}, {texRight, 0}},
+                {{left, bottom}, {0, texBottom}},
+                {{left, top}, {0, 0}}
+            };
+            memcpy(&vertexes[index * 4], quad, sizeof(quad));
+        }
+    }
+
+    glGenBuffers(1, &grid->vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, grid->vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(*vertexes) * 4 * tileCount, vertexes,
+        GL_STATIC_DRAW);
+    free(vertexes);
+
+    return 0;
+}
+
+int textureGridUpload(textureGrid* grid, const imageView* band, size_t firstRow) {
+    size_t lastRow = firstRow + band->height;
+    size_t firstTile, endTile;
+    gridBand work = { grid, band, firstRow, 0 };
+    int status = 0;
+    double start, upload;
+
+    if(band->height == 0) {
+        return 0;
+    }
+    start = traceBegin();
+
+    // Every tile in the rows of tiles the band overlaps
+    firstTile = firstRow / grid->tileSize * grid->columns;
+    endTile = ((lastRow - 1) / grid->tileSize + 1) * grid->columns;
+    work.firstTile = firstTile;
+
+    // The tiles' chains are independent, so their rows are built in
+    // parallel; only the GL calls below must stay on this thread.
+    if(grid->pool == NULL || poolParallelFor(grid->pool, 0, endTile - firstTile,
+            1, textureGridBuildRange, &work) < 0) {
+        textureGridBuildRange(&work, 0, endTile - firstTile);
+    }
+
+    upload = traceBegin();
+    for(size_t index = firstTile; index < endTile; index++) {
+        gridTile* tile = &grid->tiles[index];
+
+        if(tile->failed) {
+            status = -1;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, grid->textures[index]);
+        for(size_t level = 0; level < tile->chain.levelCount; level++) {
+            mipLevel* mip = &tile->chain.levels[level];
+
+            if(mip->count > 0) {
+                glTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0,
+                    (GLint)mip->firstRow, (GLsizei)mip->width,
+                    (GLsizei)mip->count, GL_RGB, GL_UNSIGNED_BYTE, mip->pixels);
+            }
+        }
+        mipChainClear(&tile->chain);
+    }
+    traceEnd("texSubImage", upload);
+    traceEnd("textureUpload", start);
+
+    return status;
+}
+
+void textureGridBuildRange(void* arg, size_t begin, size_t end) {
+    gridBand* work = arg;
+    double start = traceBegin();
+
+    for(size_t i = begin; i < end; i++) {
+        textureGridBuildTile(work->grid, work->firstTile + i, work->band,
+            work->firstRow);
+    }
+    traceEnd("buildMips", start);
+}
+
+void textureGridBuildTile(textureGrid* grid, size_t index, const imageView* band,
+        size_t firstRow) {
+    gridTile* tile = &grid->tiles[index];
+    size_t x, y, tileWidth, tileHeight, top, bottom;
+
+    textureGridTileRect(grid, index % grid->columns, index / grid->columns, &x, &y,
+        &tileWidth, &tileHeight);
+
+    // The band rows that fall inside this tile
+    top = firstRow > y ? firstRow : y;
+    bottom = firstRow + band->height < y + tileHeight ?
+        firstRow + band->height : y + tileHeight;
+
+    for(size_t row = top; row < bottom; row++) {
+        const pixel* in = viewRow(band, row - firstRow) + x;
+
+        memcpy(tile->row, in, sizeof(*in) * tileWidth);
+        for(size_t i = tileWidth; i < tile->textureWidth; i++) {
+            tile->row[i] = in[tileWidth - 1];
+        }
+
+        if(mipChainPush(&tile->chain, tile->row) < 0) {
+            tile->failed = 1;
+            return;
+        }
+    }
+
+    // After the tile's last row, repeat it down to the padded height
+    if(bottom == y + tileHeight) {
+        for(size_t row = tileHeight; row < tile->textureHeight; row++) {
+            if(mipChainPush(&tile->chain, tile->row) < 0) {
+                tile->failed = 1;
+                return;
+            }
+        }
+    }
+}
+
+void textureGridDraw(const textureGrid* grid, const textureGridProgram* program,
+        mat4x4 mvp, size_t filledRows) {
+    glBindBuffer(GL_ARRAY_BUFFER, grid->vertexBuffer);
+    glVertexAttribPointer(program->position, 2, GL_FLOAT, GL_FALSE,
+        sizeof(gridVertex), (void*)0);
+    glVertexAttribPointer(program->texCoord, 2, GL_FLOAT, GL_FALSE,
+        sizeof(gridVertex), (void*)(sizeof(float) * 2));
+
+    for(size_t i = 0; i < grid->rows; i++) {
+        size_t y = i * grid->tileSize;
+        size_t tileHeight = grid->height - y < grid->tileSize ?
+            grid->height - y : grid->tileSize;
+
+        // Tiles below the last uploaded row have nothing to show yet
+        if(filledRows <= y) {
+            break;
+        }
+
+        for(size_t j = 0; j < grid->columns; j++) {
+            size_t index = i * grid->columns + j;
+
+            if(!textureGridVisible(grid, mvp, j, i)) {
+                continue;
+            }
+
+            // Filled is in texture coordinates, which span the padded height
+            glBindTexture(GL_TEXTURE_2D, grid->textures[index]);
+            glUniform1f(program->filled, filledRows >= y + tileHeight ? 1.f :
+                (filledRows - y) / (float)grid->tiles[index].textureHeight);
+            glDrawArrays(GL_TRIANGLE_STRIP, (GLint)(index * 4), 4);
+        }
+    }
+}
+
+void textureGridFree(textureGrid* grid) {
+    if(grid->tiles != NULL) {
+        for(size_t i = 0; i < grid->columns * grid->rows; i++) {
+            gridTile* tile = &grid->tiles[i];
+
+            texturePoolRelease(grid->texturePool, grid->textures[i],
+                (GLsizei)tile->textureWidth, (GLsizei)tile->textureHeight, GL_RGB,
+                (GLint)mipLevelCount(tile->textureWidth, tile->textureHeight));
+            mipChainFree(&tile->chain);
+            free(tile->row);
+        }
+        glDeleteBuffers(1, &grid->vertexBuffer);
+    }
+    free(grid->tiles);
+    free(grid->textures);
+
+    memset(grid, 0, sizeof(*grid));
+}
+
+size_t textureGridBytes(const textureGrid* grid) {
+    size_t bytes = 0;
+
+    for(size_t i = 0; i < grid->columns * grid->rows; i++) {
+        const gridTile* tile = &grid->tiles[i];
+
+        bytes += texturePoolBytes((GLsizei)tile->textureWidth,
+            (GLsizei)tile->textureHeight, GL_RGB,
+            (GLint)mipLevelCount(tile->textureWidth, tile->textureHeight));
+    }
+
+    return bytes;
+}
+
+size_t nextPowerOfTwo(size_t value) {
+    size_t power = 1;
+
+    while(power < value) {
+        power *= 2;
+    }
+
+    return power;
+}
+
+int textureGridVisible(const textureGrid* grid, mat4x4 mvp, size_t column,
+        size_t row) {
+    size_t x, y, tileWidth, tileHeight;
+    float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+    float xs[2], ys[2];
+
+    textureGridTileRect(grid, column, row, &x, &y, &tileWidth, &tileHeight);
+    xs[0] = -1 + 2.f * x / grid->width;
+    xs[1] = -1 + 2.f * (x + tileWidth) / grid->width;
+    ys[0] = 1 - 2.f * y / grid->height;
+    ys[1] = 1 - 2.f * (y + tileHeight) / grid->height;
+
+    // Clip space bounds of the transformed corners. The matrix is affine,
+    // so w stays 1 and no divide is needed.
+    for(int i = 0; i < 4; i++) {
+        vec4 corner = { xs[i & 1], ys[i >> 1], 0, 1 }, clip;
+
+        mat4x4_mul_vec4(clip, mvp, corner);
+        minX = clip[0] < minX ? clip[0] : minX;
+        maxX = clip[0] > maxX ? clip[0] : maxX;
+        minY = clip[1] < minY ? clip[1] : minY;
+        maxY = clip[1] > maxY ? clip[1] : maxY;
+    }
+
+    return maxX >= -1 && minX <= 1 && maxY >= -1 && minY <= 1;
+}
+
+void textureGridTileRect(const textureGrid* grid, size_t column, size_t row,
+        size_t* x, size_t* y, size_t* width, size_t* height) {
+    *x = column * grid->tileSize;
+    *y = row * grid->tileSize;
+    *width = grid->width - *x < grid->tileSize ? grid->width - *x : grid->tileSize;
+    *height = grid->height - *y < grid->tileSize ? grid->height - *y : grid->tileSize;
+}
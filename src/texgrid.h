@@ -0,0 +1,76 @@
+#ifndef CS430_TEXGRID_H
+#define CS430_TEXGRID_H
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2.h>
+
+#include <linmath.h>
+
+#include "mipmap.h"
+#include "pnm.h"
+#include "pool.h"
+#include "texpool.h"
+
+// Default tile edge. A power of two, so that interior tiles need no padding.
+#define CS430_TEXGRID_TILE_SIZE 2048
+
+// Per tile upload state. GLES2 only mipmaps power of two textures, so each
+// tile's texture is padded up to one by repeating its last column and row.
+typedef struct gridTile {
+    size_t textureWidth;
+    size_t textureHeight;
+    mipChain chain;
+    // One padded row, built before it is pushed down the chain
+    pixel* row;
+    int failed;
+} gridTile;
+
+// An image held as a grid of textures no larger than the GPU allows, drawn as
+// one quad per tile over the same [-1, 1] square a single texture would use.
+// Every tile carries a full mip chain built on the CPU as rows arrive, and is
+// sampled trilinearly when minified.
+typedef struct textureGrid {
+    size_t width;
+    size_t height;
+    size_t tileSize;
+    size_t columns;
+    size_t rows;
+    GLuint* textures;
+    gridTile* tiles;
+    // Four triangle strip vertices per tile, in row-major tile order
+    GLuint vertexBuffer;
+    // Builds the mip rows of the tiles a band touches in parallel; may be NULL
+    threadPool* pool;
+    // Where tile textures come from and go back to; may be NULL
+    texturePool* texturePool;
+} textureGrid;
+
+// Attribute and uniform locations of the program the grid is drawn with.
+// filled is a float uniform; fragments below that fraction of a tile's
+// height must be discarded.
+typedef struct textureGridProgram {
+    GLint position;
+    GLint texCoord;
+    GLint filled;
+} textureGridProgram;
+
+// Allocates every tile and mip level at its final size without any pixel
+// data, reusing idle textures from texturePool where they match. tileSize 0
+// uses CS430_TEXGRID_TILE_SIZE, or GL_MAX_TEXTURE_SIZE if that is smaller.
+int textureGridCreate(textureGrid* grid, size_t width, size_t height,
+    size_t tileSize, threadPool* pool, texturePool* texturePool);
+// Uploads a band of full width rows starting at image row firstRow, and the
+// mip rows it completes, into each tile it overlaps. Bands must arrive in
+// order from row 0.
+int textureGridUpload(textureGrid* grid, const imageView* band, size_t firstRow);
+// Draws the tiles that land inside clip space under mvp, showing only the
+// first filledRows rows of the image. The program must be in use.
+void textureGridDraw(const textureGrid* grid, const textureGridProgram* program,
+    mat4x4 mvp, size_t filledRows);
+// Memory the grid's textures take, every tile at its padded size with its
+// whole mip chain, counted as texturePoolBytes does.
+size_t textureGridBytes(const textureGrid* grid);
+// Hands the tile textures back to the texture pool.
+void textureGridFree(textureGrid* grid);
+
+#endif // CS430_TEXGRID_H
@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "texpool.h"
+
+void texturePoolDrop(texturePool* pool, size_t index);
+
+void texturePoolInit(texturePool* pool, size_t budget) {
+    memset(pool, 0, sizeof(*pool));
+    pool->budget = budget;
+}
+
+GLuint texturePoolAcquire(texturePool* pool, GLsizei width, GLsizei height,
+        GLenum format, GLint levels) {
+    GLuint texture;
+
+    if(pool != NULL) {
+        // Newest first, as it is the likeliest to still be resident
+        for(size_t i = pool->count; i-- > 0;) {
+            pooledTexture* entry = &pool->idle[i];
+
+            if(entry->width == width && entry->height == height &&
+                    entry->format == format && entry->levels == levels) {
+                texture = entry->texture;
+                pool->idleBytes -= texturePoolBytes(width, height, format, levels);
+                memmove(entry, entry + 1, sizeof(*entry) * (pool->count - i - 1));
+                pool->count--;
+                pool->reused++;
+
+                glBindTexture(GL_TEXTURE_2D, texture);
+                return texture;
+            }
+        }
+        pool->allocated++;
+    }
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    for(GLint level = 0; level < levels; level++) {
+        GLsizei levelWidth = width >> level, levelHeight = height >> level;
+
+        glTexImage2D(GL_TEXTURE_2D, level, format,
+            levelWidth > 0 ? levelWidth : 1, levelHeight > 0 ? levelHeight : 1, 0,
+            format, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    return texture;
+}
+
+void texturePoolRelease(texturePool* pool, GLuint texture, GLsizei width,
+        GLsizei height, GLenum format, GLint levels) {
+    size_t bytes = texturePoolBytes(width, height, format, levels);
+
+    if(texture == 0) {
+        return;
+    }
+
+    if(pool == NULL || bytes > pool->budget) {
+        glDeleteTextures(1, &texture);
+        return;
+    }
+
+    // Make room by deleting the oldest idle textures
+    while(pool->count > 0 && pool->idleBytes + bytes > pool->budget) {
+        texturePoolDrop(pool, 0);
+    }
+
+    if(pool->count == pool->capacity) {
+        size_t capacity = pool->capacity == 0 ? 64 : pool->capacity * 2;
+        pooledTexture* grown;
+
+        if((grown = realloc(pool->idle, sizeof(*grown) * capacity)) == NULL) {
+            glDeleteTextures(1, &texture);
+            return;
+        }
+        pool->idle = grown;
+        pool->capacity = capacity;
+    }
+
+    pool->idle[pool->count].texture = texture;
+    pool->idle[pool->count].width = width;
+    pool->idle[pool->count].height = height;
+    pool->idle[pool->count].format = format;
+    pool->idle[pool->count].levels = levels;
+    pool->count++;
+    pool->idleBytes += bytes;
+}
+
+void texturePoolFree(texturePool* pool) {
+    while(pool->count > 0) {
+        texturePoolDrop(pool, pool->count - 1);
+    }
+    free(pool->idle);
+
+    texturePoolInit(pool, pool->budget);
+}
+
+size_t texturePoolBytes(GLsizei width, GLsizei height, GLenum format,
+        GLint levels) {
+    // Drivers generally pad RGB texels out to RGBA in video memory
+    size_t pixelBytes = format == GL_RGBA || format == GL_RGB ? 4 :
+        format == GL_LUMINANCE_ALPHA ? 2 : 1;
+    size_t bytes = 0;
+
+    for(GLint level = 0; level < levels; level++) {
+        size_t levelWidth = (size_t)width >> level, levelHeight = (size_t)height >> level;
+
+        bytes += pixelBytes * (levelWidth > 0 ? levelWidth : 1) *
+            (levelHeight > 0 ? levelHeight : 1);
+    }
+
+    return bytes;
+}
+
+void texturePoolDrop(texturePool* pool, size_t index) {
+    pooledTexture* entry = &pool->idle[index];
+
+    glDeleteTextures(1, &entry->texture);
+    pool->idleBytes -= texturePoolBytes(entry->width, entry->height,
+        entry->format, entry->levels);
+    memmove(entry, entry + 1, sizeof(*entry) * (pool->count - index - 1));
+    pool->count--;
+}
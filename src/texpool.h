@@ -0,0 +1,54 @@
+#ifndef CS430_TEXPOOL_H
+#define CS430_TEXPOOL_H
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2.h>
+
+#include <stddef.h>
+
+// Idle texture bytes kept for reuse
+#define CS430_TEXTURE_POOL_BUDGET (128 << 20)
+
+typedef struct pooledTexture {
+    GLuint texture;
+    GLsizei width;
+    GLsizei height;
+    GLenum format;
+    GLint levels;
+} pooledTexture;
+
+// Textures handed back once an image or tile is done with them, kept with
+// their storage so the next one of the same size and format is refilled with
+// glTexSubImage2D rather than reallocated by the driver. Idle textures past
+// the byte budget are deleted, oldest first. Render thread only.
+typedef struct texturePool {
+    // Oldest first
+    pooledTexture* idle;
+    size_t count;
+    size_t capacity;
+    size_t idleBytes;
+    size_t budget;
+    // Acquisitions served from the idle list and by a fresh allocation
+    size_t reused;
+    size_t allocated;
+} texturePool;
+
+void texturePoolInit(texturePool* pool, size_t budget);
+// Returns a texture with storage for levels mip levels of width x height in
+// format, bound to GL_TEXTURE_2D. Its contents are undefined. pool may be
+// NULL, in which case the texture is always newly allocated.
+GLuint texturePoolAcquire(texturePool* pool, GLsizei width, GLsizei height,
+    GLenum format, GLint levels);
+// Hands back a texture acquired with the same size, format and levels. With a
+// NULL pool, or a texture of 0, this is the same as deleting it.
+void texturePoolRelease(texturePool* pool, GLuint texture, GLsizei width,
+    GLsizei height, GLenum format, GLint levels);
+// Deletes every idle texture.
+void texturePoolFree(texturePool* pool);
+// Video memory taken by a texture of levels mip levels, counting RGB texels as
+// 4 bytes like RGBA ones. Used for the pool's budget and by anything else
+// reporting texture memory, so the figures agree.
+size_t texturePoolBytes(GLsizei width, GLsizei height, GLenum format,
+    GLint levels);
+
+#endif // CS430_TEXPOOL_H
@@ -0,0 +1,209 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+
+#include "thread.h"
+
+typedef struct threadStart {
+    threadFn fn;
+    void* arg;
+} threadStart;
+
+#ifdef _WIN32
+static unsigned __stdcall threadEntry(void* arg) {
+#else
+static void* threadEntry(void* arg) {
+#endif
+    threadStart start = *(threadStart*)arg;
+    free(arg);
+
+    start.fn(start.arg);
+
+    return 0;
+}
+
+int threadCreate(thread* handle, threadFn fn, void* arg) {
+    threadStart* start;
+
+    if((start = malloc(sizeof(*start))) == NULL) {
+        return -1;
+    }
+    start->fn = fn;
+    start->arg = arg;
+
+#ifdef _WIN32
+    if((handle->handle = (void*)_beginthreadex(NULL, 0, threadEntry, start, 0,
+            NULL)) == NULL) {
+        free(start);
+        return -1;
+    }
+#else
+    if(pthread_create(&handle->handle, NULL, threadEntry, start) != 0) {
+        free(start);
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+int threadJoin(thread* handle) {
+#ifdef _WIN32
+    if(WaitForSingleObject(handle->handle, INFINITE) != WAIT_OBJECT_0) {
+        return -1;
+    }
+    CloseHandle(handle->handle);
+    handle->handle = NULL;
+#else
+    if(pthread_join(handle->handle, NULL) != 0) {
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+void threadYield(void) {
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+size_t cpuCount(void) {
+#ifdef _WIN32
+    // Counts across all processor groups, so hosts with more than 64 logical
+    // processors are not capped to the current group.
+    DWORD count = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return count < 1 ? 1 : (size_t)count;
+}
+
+int mutexInit(mutex* lock) {
+#ifdef _WIN32
+    InitializeSRWLock((PSRWLOCK)&lock->lock);
+    return 0;
+#else
+    return pthread_mutex_init(&lock->lock, NULL) == 0 ? 0 : -1;
+#endif
+}
+
+void mutexLock(mutex* lock) {
+#ifdef _WIN32
+    AcquireSRWLockExclusive((PSRWLOCK)&lock->lock);
+#else
+    pthread_mutex_lock(&lock->lock);
+#endif
+}
+
+void mutexUnlock(mutex* lock) {
+#ifdef _WIN32
+    ReleaseSRWLockExclusive((PSRWLOCK)&lock->lock);
+#else
+    pthread_mutex_unlock(&lock->lock);
+#endif
+}
+
+void mutexDestroy(mutex* lock) {
+#ifdef _WIN32
+    // SRW locks hold no resources
+    (void)lock;
+#else
+    pthread_mutex_destroy(&lock->lock);
+#endif
+}
+
+int conditionInit(condition* cond) {
+#ifdef _WIN32
+    InitializeConditionVariable((PCONDITION_VARIABLE)&cond->cond);
+    return 0;
+#else
+    return pthread_cond_init(&cond->cond, NULL) == 0 ? 0 : -1;
+#endif
+}
+
+void conditionWait(condition* cond, mutex* lock) {
+#ifdef _WIN32
+    SleepConditionVariableSRW((PCONDITION_VARIABLE)&cond->cond,
+        (PSRWLOCK)&lock->lock, INFINITE, 0);
+#else
+    pthread_cond_wait(&cond->cond, &lock->lock);
+#endif
+}
+
+void conditionSignal(condition* cond) {
+#ifdef _WIN32
+    WakeConditionVariable((PCONDITION_VARIABLE)&cond->cond);
+#else
+    pthread_cond_signal(&cond->cond);
+#endif
+}
+
+void conditionBroadcast(condition* cond) {
+#ifdef _WIN32
+    WakeAllConditionVariable((PCONDITION_VARIABLE)&cond->cond);
+#else
+    pthread_cond_broadcast(&cond->cond);
+#endif
+}
+
+void conditionDestroy(condition* cond) {
+#ifdef _WIN32
+    // Condition variables hold no resources
+    (void)cond;
+#else
+    pthread_cond_destroy(&cond->cond);
+#endif
+}
+
+long atomicIncrement(volatile long* value) {
+#ifdef _WIN32
+    return InterlockedIncrement(value);
+#else
+    return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+long atomicDecrement(volatile long* value) {
+#ifdef _WIN32
+    return InterlockedDecrement(value);
+#else
+    return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+long atomicAdd(volatile long* value, long amount) {
+#ifdef _WIN32
+    return InterlockedExchangeAdd(value, amount) + amount;
+#else
+    return __atomic_add_fetch(value, amount, __ATOMIC_SEQ_CST);
+#endif
+}
+
+long atomicLoad(volatile long* value) {
+#ifdef _WIN32
+    return InterlockedCompareExchange(value, 0, 0);
+#else
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+void atomicStore(volatile long* value, long newValue) {
+#ifdef _WIN32
+    InterlockedExchange(value, newValue);
+#else
+    __atomic_store_n(value, newValue, __ATOMIC_SEQ_CST);
+#endif
+}
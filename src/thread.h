@@ -0,0 +1,70 @@
+#ifndef CS430_THREAD_H
+#define CS430_THREAD_H
+
+#include <stddef.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#ifdef _WIN32
+#define CS430_THREAD_LOCAL __declspec(thread)
+#else
+#define CS430_THREAD_LOCAL __thread
+#endif
+
+typedef void (*threadFn)(void* arg);
+
+// Thin wrappers over Win32 threads / pthreads. On Windows the SRWLOCK and
+// CONDITION_VARIABLE types are a single pointer, so they are stored as one to
+// keep <windows.h> out of every file that includes this header.
+#ifdef _WIN32
+typedef struct thread {
+    void* handle;
+} thread;
+
+typedef struct mutex {
+    void* lock;
+} mutex;
+
+typedef struct condition {
+    void* cond;
+} condition;
+#else
+typedef struct thread {
+    pthread_t handle;
+} thread;
+
+typedef struct mutex {
+    pthread_mutex_t lock;
+} mutex;
+
+typedef struct condition {
+    pthread_cond_t cond;
+} condition;
+#endif
+
+int threadCreate(thread* handle, threadFn fn, void* arg);
+int threadJoin(thread* handle);
+void threadYield(void);
+size_t cpuCount(void);
+
+int mutexInit(mutex* lock);
+void mutexLock(mutex* lock);
+void mutexUnlock(mutex* lock);
+void mutexDestroy(mutex* lock);
+
+int conditionInit(condition* cond);
+void conditionWait(condition* cond, mutex* lock);
+void conditionSignal(condition* cond);
+void conditionBroadcast(condition* cond);
+void conditionDestroy(condition* cond);
+
+// Sequentially consistent atomics on a long; each returns the new value.
+long atomicIncrement(volatile long* value);
+long atomicDecrement(volatile long* value);
+long atomicAdd(volatile long* value, long amount);
+long atomicLoad(volatile long* value);
+void atomicStore(volatile long* value, long newValue);
+
+#endif // CS430_THREAD_H
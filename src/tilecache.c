@@ -0,0 +1,548 @@
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "tilecache.h"
+#include "trace.h"
+#include "view.h"
+
+#define CS430_CACHE_READS_PER_THREAD 4
+
+typedef enum cacheState {
+    CACHE_PENDING,
+    CACHE_RESIDENT,
+    CACHE_FAILED
+} cacheState;
+
+struct cacheTile {
+    tileCache* cache;
+    size_t level;
+    size_t column;
+    size_t row;
+    size_t width;
+    size_t height;
+    cacheState state;
+    // Owned from the read until the upload
+    pixel* pixels;
+    int failed;
+    GLuint texture;
+    unsigned long lastUsed;
+    // Frame the tile was last put on the draw list, so stand-ins shared by
+    // several missing tiles are drawn once
+    unsigned long drawn;
+    cacheTile* prev;
+    cacheTile* next;
+    cacheTile* nextDone;
+};
+
+typedef struct cacheVertex {
+    float position[2];
+    float texCoord[2];
+} cacheVertex;
+
+cacheTile** cacheSlot(tileCache* cache, size_t level, size_t column, size_t row);
+cacheTile* cacheRequest(tileCache* cache, size_t level, size_t column, size_t row);
+void cacheReadTask(void* arg);
+void cacheUpload(tileCache* cache, cacheTile* tile);
+void cacheDrainDone(tileCache* cache, uploadBudget* budget);
+void cacheTouch(tileCache* cache, cacheTile* tile);
+void cacheUnlink(tileCache* cache, cacheTile* tile);
+void cacheEvict(tileCache* cache);
+void cacheFreeTile(tileCache* cache, cacheTile* tile);
+cacheTile* cacheAncestor(tileCache* cache, size_t level, size_t column, size_t row);
+size_t cacheChooseLevel(const tileCache* cache, mat4x4 mvp, int viewportWidth,
+    int viewportHeight);
+int cacheVisibleRange(const tileCache* cache, size_t level, mat4x4 mvp,
+    size_t* firstColumn, size_t* endColumn, size_t* firstRow, size_t* endRow);
+int cacheDrawAppend(tileCache* cache, size_t* count, cacheTile* tile);
+int cacheCompareLevel(const void* a, const void* b);
+
+int tileCacheOpen(tileCache* cache, const char* path, size_t budget,
+        threadPool* pool, texturePool* texturePool, readContext* ctx) {
+    size_t slotCount = 0;
+    size_t top;
+
+    memset(cache, 0, sizeof(*cache));
+
+    if(pyramidOpen(&cache->pyramid, path, ctx) < 0) {
+        return -1;
+    }
+
+    if((cache->levelBase = malloc(sizeof(*cache->levelBase) *
+            cache->pyramid.levelCount)) == NULL) {
+        pyramidClose(&cache->pyramid);
+        return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on tile cache");
+    }
+    for(size_t i = 0; i < cache->pyramid.levelCount; i++) {
+        cache->levelBase[i] = slotCount;
+        slotCount += cache->pyramid.levels[i].columns * cache->pyramid.levels[i].rows;
+    }
+
+    if((cache->slots = calloc(slotCount, sizeof(*cache->slots))) == NULL) {
+        free(cache->levelBase);
+        pyramidClose(&cache->pyramid);
+        return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+            "Memory allocation error on tile cache");
+    }
+
+    mutexInit(&cache->doneLock);
+    poolGroupInit(&cache->group);
+    cache->pool = pool;
+    cache->texturePool = texturePool;
+    cache->budget = budget;
+    cache->maxInFlight = pool != NULL ?
+        poolThreadCount(pool) * CS430_CACHE_READS_PER_THREAD : 1;
+
+    // Every tile is drawn as this quad under its own model matrix
+    cacheVertex quad[4] = {
+        {{1, -1}, {1, 1}},
+        {{1, 1}, {1, 0}},
+        {{-1, -1}, {0, 1}},
+        {{-1, 1}, {0, 0}}
+    };
+    glGenBuffers(1, &cache->vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, cache->vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+    // The top level is read here on this thread and never evicted
+    top = cache->pyramid.levelCount - 1;
+    for(size_t i = 0; i < cache->pyramid.levels[top].rows; i++) {
+        for(size_t j = 0; j < cache->pyramid.levels[top].columns; j++) {
+            cacheTile* tile = cacheRequest(cache, top, j, i);
+
+            if(tile == NULL) {
+                tileCacheClose(cache);
+                return readContextFail(ctx, READ_ERROR_MEMORY, 0,
+                    "Memory allocation error on tile cache");
+            }
+        }
+    }
+    if(cache->pool != NULL) {
+        poolWait(cache->pool, &cache->group);
+    }
+    cacheDrainDone(cache, NULL);
+
+    return 0;
+}
+
+void tileCacheDraw(tileCache* cache, const textureGridProgram* program,
+        GLint mvpLocation, mat4x4 mvp, int viewportWidth, int viewportHeight,
+        uploadBudget* budget) {
+    size_t level, firstColumn, endColumn, firstRow, endRow, count = 0;
+
+    cache->frame++;
+    // A tile is about one upload band, so finished reads go up a tile at a
+    // time until the frame's budget is spent
+    cacheDrainDone(cache, budget);
+
+    level = cacheChooseLevel(cache, mvp, viewportWidth, viewportHeight);
+
+    if(cacheVisibleRange(cache, level, mvp, &firstColumn, &endColumn, &firstRow,
+            &endRow) == 0) {
+        for(size_t i = firstRow; i < endRow; i++) {
+            for(size_t j = firstColumn; j < endColumn; j++) {
+                cacheTile* tile = *cacheSlot(cache, level, j, i);
+
+                if(tile == NULL) {
+                    tile = cacheRequest(cache, level, j, i);
+                }
+
+                // Otherwise stand in with the closest coarser tile
+                if(tile == NULL || tile->state != CACHE_RESIDENT) {
+                    tile = cacheAncestor(cache, level, j, i);
+                }
+
+                if(tile != NULL && tile->drawn != cache->frame) {
+                    cacheTouch(cache, tile);
+                    tile->drawn = cache->frame;
+                    cacheDrawAppend(cache, &count, tile);
+                }
+            }
+        }
+    }
+
+    // Coarse stand-ins first, so finer tiles land on top of them
+    qsort(cache->drawList, count, sizeof(*cache->drawList), cacheCompareLevel);
+
+    glBindBuffer(GL_ARRAY_BUFFER, cache->vertexBuffer);
+    glVertexAttribPointer(program->position, 2, GL_FLOAT, GL_FALSE,
+        sizeof(cacheVertex), (void*)0);
+    glVertexAttribPointer(program->texCoord, 2, GL_FLOAT, GL_FALSE,
+        sizeof(cacheVertex), (void*)(sizeof(float) * 2));
+    glUniform1f(program->filled, 1.f);
+
+    for(size_t i = 0; i < count; i++) {
+        cacheTile* tile = cache->drawList[i];
+        const pyramidLevel* info = &cache->pyramid.levels[tile->level];
+        size_t x, y, width, height;
+        float left, right, top, bottom;
+        mat4x4 model, tileMvp;
+
+        pyramidTileRect(&cache->pyramid, tile->level, tile->column, tile->row,
+            &x, &y, &width, &height);
+        left = -1 + 2.f * x / info->width;
+        right = -1 + 2.f * (x + width) / info->width;
+        top = 1 - 2.f * y / info->height;
+        bottom = 1 - 2.f * (y + height) / info->height;
+
+        // Maps the [-1, 1] quad onto the tile's part of the image square
+        mat4x4_identity(model);
+        model[0][0] = (right - left) / 2;
+        model[1][1] = (top - bottom) / 2;
+        model[3][0] = (right + left) / 2;
+        model[3][1] = (top + bottom) / 2;
+        mat4x4_mul(tileMvp, mvp, model);
+
+        glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, (const GLfloat*)tileMvp);
+        glBindTexture(GL_TEXTURE_2D, tile->texture);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    // Leave the uniform as the caller set it
+    glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, (const GLfloat*)mvp);
+
+    cacheEvict(cache);
+}
+
+int tileCacheHasUploads(tileCache* cache) {
+    int waiting;
+
+    mutexLock(&cache->doneLock);
+    waiting = cache->done != NULL;
+    mutexUnlock(&cache->doneLock);
+
+    return waiting;
+}
+
+void tileCacheClose(tileCache* cache) {
+    size_t slotCount;
+    const pyramidLevel* last;
+
+    if(cache->slots == NULL) {
+        return;
+    }
+
+    if(cache->pool != NULL) {
+        poolWait(cache->pool, &cache->group);
+    }
+
+    // Finished reads still own their pixels
+    while(cache->done != NULL) {
+        cacheTile* tile = cache->done;
+
+        cache->done = tile->nextDone;
+        free(tile->pixels);
+        tile->pixels = NULL;
+    }
+
+    last = &cache->pyramid.levels[cache->pyramid.levelCount - 1];
+    slotCount = cache->levelBase[cache->pyramid.levelCount - 1] +
+        last->columns * last->rows;
+    for(size_t i = 0; i < slotCount; i++) {
+        if(cache->slots[i] != NULL) {
+            if(cache->slots[i]->state == CACHE_RESIDENT) {
+                texturePoolRelease(cache->texturePool, cache->slots[i]->texture,
+                    (GLsizei)cache->slots[i]->width, (GLsizei)cache->slots[i]->height,
+                    GL_RGB, 1);
+            }
+            free(cache->slots[i]);
+        }
+    }
+
+    glDeleteBuffers(1, &cache->vertexBuffer);
+    mutexDestroy(&cache->doneLock);
+    free(cache->drawList);
+    free(cache->slots);
+    free(cache->levelBase);
+    pyramidClose(&cache->pyramid);
+
+    memset(cache, 0, sizeof(*cache));
+}
+
+cacheTile** cacheSlot(tileCache* cache, size_t level, size_t column, size_t row) {
+    return &cache->slots[cache->levelBase[level] + row *
+        cache->pyramid.levels[level].columns + column];
+}
+
+cacheTile* cacheRequest(tileCache* cache, size_t level, size_t column, size_t row) {
+    cacheTile* tile;
+    size_t x, y;
+
+    // Visible tiles past the cap are asked for again on a later frame
+    if(cache->inFlight >= cache->maxInFlight && level + 1 < cache->pyramid.levelCount) {
+        return NULL;
+    }
+
+    if((tile = calloc(1, sizeof(*tile))) == NULL) {
+        return NULL;
+    }
+
+    tile->cache = cache;
+    tile->level = level;
+    tile->column = column;
+    tile->row = row;
+    tile->state = CACHE_PENDING;
+    pyramidTileRect(&cache->pyramid, level, column, row, &x, &y, &tile->width,
+        &tile->height);
+
+    *cacheSlot(cache, level, column, row) = tile;
+    cache->inFlight++;
+
+    if(cache->pool == NULL || poolSubmit(cache->pool, &cache->group,
+            cacheReadTask, tile) < 0) {
+        cacheReadTask(tile);
+    }
+
+    return tile;
+}
+
+void cacheReadTask(void* arg) {
+    cacheTile* tile = arg;
+    tileCache* cache = tile->cache;
+    readContext ctx;
+    double start = traceBegin();
+
+    readContextInit(&ctx);
+
+    if((tile->pixels = malloc(sizeof(*tile->pixels) * tile->width *
+            tile->height)) == NULL) {
+        tile->failed = 1;
+    }
+    else {
+        imageView view = viewMake(tile->pixels, tile->width, tile->height,
+            tile->width);
+
+        // Positioned reads, so the pool's reads overlap
+        tile->failed = pyramidReadTile(&cache->pyramid, tile->level, tile->column,
+            tile->row, &view, &ctx) < 0;
+    }
+    traceEnd("readTile", start);
+
+    mutexLock(&cache->doneLock);
+    tile->nextDone = cache->done;
+    cache->done = tile;
+    mutexUnlock(&cache->doneLock);
+
+    if(cache->notify != NULL) {
+        cache->notify(cache->notifyArg);
+    }
+}
+
+void cacheDrainDone(tileCache* cache, uploadBudget* budget) {
+    while(uploadBudgetAvailable(budget)) {
+        cacheTile* tile;
+        size_t bytes;
+        double start;
+
+        mutexLock(&cache->doneLock);
+        if((tile = cache->done) != NULL) {
+            cache->done = tile->nextDone;
+        }
+        mutexUnlock(&cache->doneLock);
+
+        if(tile == NULL) {
+            return;
+        }
+
+        cache->inFlight--;
+        bytes = tile->failed ? 0 : sizeof(pixel) * tile->width * tile->height;
+        start = clockSeconds();
+        cacheUpload(cache, tile);
+        uploadBudgetCharge(budget, start, bytes);
+    }
+}
+
+void cacheUpload(tileCache* cache, cacheTile* tile) {
+    double start;
+
+    // A failed tile keeps its slot so it is not asked for again
+    if(tile->failed) {
+        tile->state = CACHE_FAILED;
+        free(tile->pixels);
+        tile->pixels = NULL;
+        return;
+    }
+
+    start = traceBegin();
+    tile->texture = texturePoolAcquire(cache->texturePool, (GLsizei)tile->width,
+        (GLsizei)tile->height, GL_RGB, 1);
+    // Tiles are at most a level's own resolution, so minification is slight
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Required for NPOT textures in GLES2, and keeps edges from wrapping
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, (GLsizei)tile->width,
+        (GLsizei)tile->height, GL_RGB, GL_UNSIGNED_BYTE, tile->pixels);
+    traceEnd("tileUpload", start);
+
+    free(tile->pixels);
+    tile->pixels = NULL;
+    tile->state = CACHE_RESIDENT;
+
+    // The top level is pinned, so it never enters the eviction order
+    if(tile->level + 1 < cache->pyramid.levelCount) {
+        cache->residentBytes += sizeof(pixel) * tile->width * tile->height;
+        tile->lastUsed = cache->frame;
+        tile->next = cache->lruHead;
+        if(cache->lruHead != NULL) {
+            cache->lruHead->prev = tile;
+        }
+        cache->lruHead = tile;
+        if(cache->lruTail == NULL) {
+            cache->lruTail = tile;
+        }
+    }
+}
+
+void cacheTouch(tileCache* cache, cacheTile* tile) {
+    tile->lastUsed = cache->frame;
+
+    if(tile->level + 1 == cache->pyramid.levelCount || cache->lruHead == tile) {
+        return;
+    }
+
+    cacheUnlink(cache, tile);
+    tile->next = cache->lruHead;
+    cache->lruHead->prev = tile;
+    cache->lruHead = tile;
+}
+
+void cacheUnlink(tileCache* cache, cacheTile* tile) {
+    if(tile->prev != NULL) {
+        tile->prev->next = tile->next;
+    }
+    else {
+        cache->lruHead = tile->next;
+    }
+
+    if(tile->next != NULL) {
+        tile->next->prev = tile->prev;
+    }
+    else {
+        cache->lruTail = tile->prev;
+    }
+
+    tile->prev = NULL;
+    tile->next = NULL;
+}
+
+void cacheEvict(tileCache* cache) {
+    // Tiles drawn this frame are never evicted, even over budget
+    while(cache->residentBytes > cache->budget && cache->lruTail != NULL &&
+            cache->lruTail->lastUsed != cache->frame) {
+        cacheFreeTile(cache, cache->lruTail);
+    }
+}
+
+void cacheFreeTile(tileCache* cache, cacheTile* tile) {
+    cacheUnlink(cache, tile);
+    texturePoolRelease(cache->texturePool, tile->texture, (GLsizei)tile->width,
+        (GLsizei)tile->height, GL_RGB, 1);
+    cache->residentBytes -= sizeof(pixel) * tile->width * tile->height;
+    *cacheSlot(cache, tile->level, tile->column, tile->row) = NULL;
+    free(tile);
+}
+
+cacheTile* cacheAncestor(tileCache* cache, size_t level, size_t column, size_t row) {
+    for(size_t i = level + 1; i < cache->pyramid.levelCount; i++) {
+        cacheTile* tile;
+
+        column /= 2;
+        row /= 2;
+        tile = *cacheSlot(cache, i, column, row);
+        if(tile != NULL && tile->state == CACHE_RESIDENT) {
+            return tile;
+        }
+    }
+
+    return NULL;
+}
+
+size_t cacheChooseLevel(const tileCache* cache, mat4x4 mvp, int viewportWidth,
+        int viewportHeight) {
+    // Screen pixels covered by one full resolution texel along each axis
+    float alongX = sqrtf(powf(mvp[0][0] * viewportWidth / 2, 2) +
+        powf(mvp[0][1] * viewportHeight / 2, 2)) * 2 / cache->pyramid.width;
+    float alongY = sqrtf(powf(mvp[1][0] * viewportWidth / 2, 2) +
+        powf(mvp[1][1] * viewportHeight / 2, 2)) * 2 / cache->pyramid.height;
+    float texelsPerPixel = 1 / (alongX < alongY ? alongX : alongY);
+    size_t level = 0;
+
+    // Each level halves the texels; stop at the first within 2x of the screen
+    while(level + 1 < cache->pyramid.levelCount && texelsPerPixel >= 2) {
+        texelsPerPixel /= 2;
+        level++;
+    }
+
+    return level;
+}
+
+int cacheVisibleRange(const tileCache* cache, size_t level, mat4x4 mvp,
+        size_t* firstColumn, size_t* endColumn, size_t* firstRow, size_t* endRow) {
+    const pyramidLevel* info = &cache->pyramid.levels[level];
+    float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+    float left, right, top, bottom;
+    mat4x4 inverse;
+
+    // Bounds of the viewport's corners carried back into the image square
+    mat4x4_invert(inverse, mvp);
+    for(int i = 0; i < 4; i++) {
+        vec4 corner = { i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f, 0, 1 }, model;
+
+        mat4x4_mul_vec4(model, inverse, corner);
+        minX = model[0] < minX ? model[0] : minX;
+        maxX = model[0] > maxX ? model[0] : maxX;
+        minY = model[1] < minY ? model[1] : minY;
+        maxY = model[1] > maxY ? model[1] : maxY;
+    }
+
+    if(maxX < -1 || minX > 1 || maxY < -1 || minY > 1) {
+        return -1;
+    }
+
+    // To level pixels, with row 0 at the top of the square
+    left = (minX < -1 ? -1 : minX) + 1;
+    right = (maxX > 1 ? 1 : maxX) + 1;
+    top = 1 - (maxY > 1 ? 1 : maxY);
+    bottom = 1 - (minY < -1 ? -1 : minY);
+
+    *firstColumn = (size_t)(left / 2 * info->width) / cache->pyramid.tileSize;
+    *endColumn = (size_t)(right / 2 * info->width) / cache->pyramid.tileSize + 1;
+    *firstRow = (size_t)(top / 2 * info->height) / cache->pyramid.tileSize;
+    *endRow = (size_t)(bottom / 2 * info->height) / cache->pyramid.tileSize + 1;
+
+    *endColumn = *endColumn > info->columns ? info->columns : *endColumn;
+    *endRow = *endRow > info->rows ? info->rows : *endRow;
+
+    return 0;
+}
+
+int cacheDrawAppend(tileCache* cache, size_t* count, cacheTile* tile) {
+    if(*count == cache->drawCapacity) {
+        size_t capacity = cache->drawCapacity == 0 ? 64 : cache->drawCapacity * 2;
+        cacheTile** grown;
+
+        // Skipping a tile only leaves a gap for one frame
+        if((grown = realloc(cache->drawList, sizeof(*grown) * capacity)) == NULL) {
+            return -1;
+        }
+        cache->drawList = grown;
+        cache->drawCapacity = capacity;
+    }
+
+    cache->drawList[(*count)++] = tile;
+
+    return 0;
+}
+
+int cacheCompareLevel(const void* a, const void* b) {
+    const cacheTile* left = *(cacheTile* const*)a;
+    const cacheTile* right = *(cacheTile* const*)b;
+
+    return (left->level < right->level) - (left->level > right->level);
+}
@@ -0,0 +1,77 @@
+#ifndef CS430_TILECACHE_H
+#define CS430_TILECACHE_H
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2.h>
+
+#include <linmath.h>
+
+#include "pool.h"
+#include "pyramid.h"
+#include "texgrid.h"
+#include "texpool.h"
+#include "thread.h"
+#include "upload.h"
+
+#define CS430_CACHE_BUDGET (256 << 20)
+
+typedef struct cacheTile cacheTile;
+
+typedef void (*tileCacheNotifyFn)(void* arg);
+
+// Pages the tiles of a pyramid in and out of textures as the view moves. The
+// level drawn is the one whose texels best match the screen's pixels; tiles
+// are read on the pool and uploaded by the render thread, and the least
+// recently drawn are deleted once the textures exceed the byte budget. While
+// a tile is on its way, the nearest coarser tile that is resident stands in.
+typedef struct tileCache {
+    tilePyramid pyramid;
+    threadPool* pool;
+    poolGroup group;
+    // Most tiles share one size, so evicted textures are refilled in place
+    texturePool* texturePool;
+
+    // One slot per tile of every level, NULL while it is not cached
+    cacheTile** slots;
+    size_t* levelBase;
+
+    // Most recently drawn first
+    cacheTile* lruHead;
+    cacheTile* lruTail;
+    size_t residentBytes;
+    size_t budget;
+    size_t inFlight;
+    size_t maxInFlight;
+
+    // Tiles the pool has finished reading, waiting for upload
+    mutex doneLock;
+    cacheTile* done;
+    // Called on the reading thread as each tile lands on the done list, so a
+    // render loop asleep in its event wait knows to draw again. May be set
+    // once tileCacheOpen returns.
+    tileCacheNotifyFn notify;
+    void* notifyArg;
+
+    unsigned long frame;
+    cacheTile** drawList;
+    size_t drawCapacity;
+    GLuint vertexBuffer;
+} tileCache;
+
+// Opens a pyramid and synchronously loads its top level, which stays resident
+// so there is always something to draw. Needs a current GL context. Either
+// pool may be NULL.
+int tileCacheOpen(tileCache* cache, const char* path, size_t budget,
+    threadPool* pool, texturePool* texturePool, readContext* ctx);
+// Draws the part of the image visible under mvp in a viewport of the given
+// size, requesting any missing tiles and uploading finished ones within
+// budget, which may be NULL. The program must be in use.
+void tileCacheDraw(tileCache* cache, const textureGridProgram* program,
+    GLint mvpLocation, mat4x4 mvp, int viewportWidth, int viewportHeight,
+    uploadBudget* budget);
+// Whether finished reads are waiting to be uploaded by the next draw.
+int tileCacheHasUploads(tileCache* cache);
+// Waits for outstanding reads and releases every texture.
+void tileCacheClose(tileCache* cache);
+
+#endif // CS430_TILECACHE_H
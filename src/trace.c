@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "thread.h"
+#include "trace.h"
+
+typedef struct traceSpan {
+    const char* name;
+    double start;
+    double end;
+} traceSpan;
+
+// One per thread that has recorded a span, kept until traceStop so that
+// spans outlive the threads that recorded them
+typedef struct traceBuffer {
+    size_t id;
+    const char* threadName;
+    traceSpan* spans;
+    size_t count;
+    size_t capacity;
+    struct traceBuffer* next;
+} traceBuffer;
+
+// Set before any traced thread starts, so read without synchronization
+static int traceEnabled = 0;
+static double traceOrigin;
+static mutex traceLock;
+// Guarded by traceLock
+static traceBuffer* traceBuffers = NULL;
+static size_t traceThreads = 0;
+static CS430_THREAD_LOCAL traceBuffer* currentBuffer = NULL;
+
+traceBuffer* traceCurrentBuffer(void);
+
+int traceStart(void) {
+    if(traceEnabled) {
+        return 0;
+    }
+
+    if(mutexInit(&traceLock) < 0) {
+        return -1;
+    }
+
+    traceOrigin = clockSeconds();
+    traceEnabled = 1;
+
+    return 0;
+}
+
+double traceBegin(void) {
+    return traceEnabled ? clockSeconds() : 0;
+}
+
+void traceEnd(const char* name, double start) {
+    traceBuffer* buffer;
+    traceSpan* span;
+
+    if(!traceEnabled || start == 0 || (buffer = traceCurrentBuffer()) == NULL) {
+        return;
+    }
+
+    if(buffer->count == buffer->capacity) {
+        size_t capacity = buffer->capacity == 0 ? 256 : buffer->capacity * 2;
+        traceSpan* grown;
+
+        // Dropping a span beats failing the work it measured
+        if((grown = realloc(buffer->spans, sizeof(*grown) * capacity)) == NULL) {
+            return;
+        }
+        buffer->spans = grown;
+        buffer->capacity = capacity;
+    }
+
+    span = &buffer->spans[buffer->count++];
+    span->name = name;
+    span->start = start;
+    span->end = clockSeconds();
+}
+
+void traceThreadName(const char* name) {
+    traceBuffer* buffer;
+
+    if(traceEnabled && (buffer = traceCurrentBuffer()) != NULL) {
+        buffer->threadName = name;
+    }
+}
+
+int traceWrite(const char* path) {
+    FILE* outputFd;
+    int first = 1;
+
+    if(!traceEnabled) {
+        return 0;
+    }
+
+    if((outputFd = fopen(path, "w")) == NULL) {
+        return -1;
+    }
+
+    fprintf(outputFd, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    mutexLock(&traceLock);
+    for(traceBuffer* buffer = traceBuffers; buffer != NULL; buffer = buffer->next) {
+        if(buffer->threadName != NULL) {
+            fprintf(outputFd, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%zu,\"args\":{\"name\":\"%s\"}}", first ? "" : ",",
+                buffer->id, buffer->threadName);
+            first = 0;
+        }
+
+        // Complete events, in microseconds from traceStart
+        for(size_t i = 0; i < buffer->count; i++) {
+            const traceSpan* span = &buffer->spans[i];
+
+            fprintf(outputFd, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                "\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",",
+                span->name, buffer->id, (span->start - traceOrigin) * 1e6,
+                (span->end - span->start) * 1e6);
+            first = 0;
+        }
+    }
+    mutexUnlock(&traceLock);
+
+    fprintf(outputFd, "\n]}\n");
+
+    if(ferror(outputFd)) {
+        fclose(outputFd);
+        return -1;
+    }
+
+    return fclose(outputFd) == 0 ? 0 : -1;
+}
+
+void traceStop(void) {
+    if(!traceEnabled) {
+        return;
+    }
+
+    traceEnabled = 0;
+
+    while(traceBuffers != NULL) {
+        traceBuffer* next = traceBuffers->next;
+
+        free(traceBuffers->spans);
+        free(traceBuffers);
+        traceBuffers = next;
+    }
+    traceThreads = 0;
+    // Only the calling thread's can be reset; the others have been joined
+    currentBuffer = NULL;
+
+    mutexDestroy(&traceLock);
+}
+
+traceBuffer* traceCurrentBuffer(void) {
+    if(currentBuffer != NULL) {
+        return currentBuffer;
+    }
+
+    if((currentBuffer = calloc(1, sizeof(*currentBuffer))) == NULL) {
+        return NULL;
+    }
+
+    mutexLock(&traceLock);
+    currentBuffer->id = ++traceThreads;
+    currentBuffer->next = traceBuffers;
+    traceBuffers = currentBuffer;
+    mutexUnlock(&traceLock);
+
+    return currentBuffer;
+}
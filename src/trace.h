@@ -0,0 +1,29 @@
+#ifndef CS430_TRACE_H
+#define CS430_TRACE_H
+
+// Records spans of work, per thread, for viewing in chrome://tracing or
+// Perfetto. Spans on one thread nest by time, so a span begun inside another
+// shows beneath it. Each thread appends to a buffer of its own, so recording
+// takes no lock after a thread's first span. While tracing is off, which it
+// is until traceStart, a span costs one branch.
+//
+//     double start = traceBegin();
+//     ...
+//     traceEnd("readBody", start);
+
+// Turns tracing on. Call before starting any thread that is to be traced.
+int traceStart(void);
+// Returns the start of a span for traceEnd, or 0 while tracing is off.
+double traceBegin(void);
+// Records a span from start until now. name must outlive the trace; in
+// practice a string literal.
+void traceEnd(const char* name, double start);
+// Labels the calling thread in the trace. name must outlive the trace.
+void traceThreadName(const char* name);
+// Writes every span recorded so far to path in the trace event JSON format.
+// Traced threads should be idle, or joined, by then.
+int traceWrite(const char* path);
+// Turns tracing off and frees every span. Traced threads must be joined.
+void traceStop(void);
+
+#endif // CS430_TRACE_H
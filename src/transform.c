@@ -0,0 +1,140 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "transform.h"
+
+#define CS430_TRANSFORM_MAX_ARGS 2
+
+const char* transformSkipBlank(const char* cursor);
+int transformCommand(mat4x4 matrix, const char* name, size_t length,
+    const double* args, size_t argCount);
+int transformNameIs(const char* name, size_t length, const char* expected);
+
+int transformApply(mat4x4 matrix, const char* script, size_t* errorOffset) {
+    const char* cursor = transformSkipBlank(script);
+
+    while(*cursor != '\0') {
+        const char* command = cursor;
+        size_t length = strspn(cursor, "abcdefghijklmnopqrstuvwxyz_");
+        double args[CS430_TRANSFORM_MAX_ARGS];
+        size_t argCount = 0;
+
+        cursor += length;
+        while(argCount < CS430_TRANSFORM_MAX_ARGS) {
+            char* end;
+            double value;
+
+            cursor += strspn(cursor, " \t\r");
+            value = strtod(cursor, &end);
+            if(end == cursor || !isfinite(value)) {
+                break;
+            }
+            args[argCount++] = value;
+            cursor = end;
+        }
+
+        // Anything left before the end of the command is a stray argument
+        cursor += strspn(cursor, " \t\r");
+        if((*cursor != '\0' && *cursor != ';' && *cursor != '\n' && *cursor != '#') ||
+                transformCommand(matrix, command, length, args, argCount) < 0) {
+            *errorOffset = (size_t)(command - script);
+            return -1;
+        }
+
+        cursor = transformSkipBlank(cursor);
+    }
+
+    return 0;
+}
+
+char* transformRead(const char* path) {
+    FILE* inputFd;
+    char* script = NULL;
+    size_t length = 0, capacity = 0;
+
+    if((inputFd = fopen(path, "r")) == NULL) {
+        return NULL;
+    }
+
+    // Scripts are a few lines, so growing as it goes is plenty
+    do {
+        if(capacity - length < 256) {
+            char* grown;
+
+            capacity = capacity == 0 ? 1024 : capacity * 2;
+            if((grown = realloc(script, capacity)) == NULL) {
+                free(script);
+                fclose(inputFd);
+                errno = ENOMEM;
+                return NULL;
+            }
+            script = grown;
+        }
+        length += fread(script + length, 1, capacity - length - 1, inputFd);
+    } while(!feof(inputFd) && !ferror(inputFd));
+
+    if(ferror(inputFd)) {
+        free(script);
+        fclose(inputFd);
+        errno = EIO;
+        return NULL;
+    }
+
+    fclose(inputFd);
+    script[length] = '\0';
+
+    return script;
+}
+
+// Skips white space, empty commands and comments
+const char* transformSkipBlank(const char* cursor) {
+    for(;;) {
+        cursor += strspn(cursor, " \t\r\n;");
+        if(*cursor != '#') {
+            return cursor;
+        }
+        cursor += strcspn(cursor, "\n");
+    }
+}
+
+int transformCommand(mat4x4 matrix, const char* name, size_t length,
+        const double* args, size_t argCount) {
+    mat4x4 transform;
+
+    mat4x4_identity(transform);
+
+    if(transformNameIs(name, length, "rotate") && argCount == 1) {
+        mat4x4_rotate_Z(matrix, matrix, (float)(args[0] * 3.14159265358979323846 / 180));
+        return 0;
+    }
+    else if(transformNameIs(name, length, "shear_x") && argCount == 1) {
+        transform[1][0] = (float)args[0];
+    }
+    else if(transformNameIs(name, length, "shear_y") && argCount == 1) {
+        transform[0][1] = (float)args[0];
+    }
+    else if(transformNameIs(name, length, "scale") && argCount >= 1) {
+        transform[0][0] = (float)args[0];
+        transform[1][1] = (float)args[argCount - 1];
+    }
+    else if(transformNameIs(name, length, "translate") && argCount == 2) {
+        mat4x4_translate(transform, (float)args[0], (float)args[1], 0);
+    }
+    else if(transformNameIs(name, length, "reset") && argCount == 0) {
+        mat4x4_identity(matrix);
+        return 0;
+    }
+    else {
+        return -1;
+    }
+
+    mat4x4_mul(matrix, matrix, transform);
+    return 0;
+}
+
+int transformNameIs(const char* name, size_t length, const char* expected) {
+    return strlen(expected) == length && strncmp(name, expected, length) == 0;
+}
@@ -0,0 +1,27 @@
+#ifndef CS430_TRANSFORM_H
+#define CS430_TRANSFORM_H
+
+#include <stddef.h>
+
+#include <linmath.h>
+
+// Applies a transform script to matrix. Each command multiplies it on the
+// right, just as the viewer's key presses do, so "rotate 90" is one press of
+// [ and "shear_x 0.1" one press of '. Commands are separated by semicolons or
+// new lines, and # starts a comment running to the end of the line.
+//
+//     rotate DEGREES          anticlockwise
+//     shear_x AMOUNT          x moves by AMOUNT * y
+//     shear_y AMOUNT          y moves by AMOUNT * x
+//     scale FACTOR [FACTOR_Y]
+//     translate X Y           the image spans -1 to 1 on both axes
+//     reset                   back to the identity
+//
+// Returns -1 at the first command it cannot parse, with errorOffset set to
+// where that command starts. The commands before it are left applied.
+int transformApply(mat4x4 matrix, const char* script, size_t* errorOffset);
+// Reads a script from path into a new string for transformApply, to be
+// released with free. Returns NULL with errno set on failure.
+char* transformRead(const char* path);
+
+#endif // CS430_TRANSFORM_H
@@ -0,0 +1,34 @@
+#include "clock.h"
+#include "pnm.h"
+#include "upload.h"
+
+void uploadBudgetInit(uploadBudget* budget, double milliseconds) {
+    budget->limit = milliseconds / 1000;
+    uploadBudgetReset(budget);
+}
+
+void uploadBudgetReset(uploadBudget* budget) {
+    budget->spent = 0;
+    budget->bytes = 0;
+    budget->bands = 0;
+}
+
+int uploadBudgetAvailable(const uploadBudget* budget) {
+    return budget == NULL || budget->bands == 0 || budget->spent < budget->limit;
+}
+
+void uploadBudgetCharge(uploadBudget* budget, double start, size_t bytes) {
+    if(budget == NULL) {
+        return;
+    }
+
+    budget->spent += clockSeconds() - start;
+    budget->bytes += bytes;
+    budget->bands++;
+}
+
+size_t uploadBandRows(size_t width) {
+    size_t rows = CS430_UPLOAD_CHUNK_BYTES / (sizeof(pixel) * width);
+
+    return rows > 0 ? rows : 1;
+}
@@ -0,0 +1,39 @@
+#ifndef CS430_UPLOAD_H
+#define CS430_UPLOAD_H
+
+#include <stddef.h>
+
+// Default time each frame may spend uploading
+#define CS430_UPLOAD_BUDGET_MS 4
+// Target size of one row band; large enough to keep the driver busy, small
+// enough that a band rarely overruns the budget by much
+#define CS430_UPLOAD_CHUNK_BYTES (256 << 10)
+
+// Time allowance for texture uploads within one frame. Uploads are split into
+// row bands of about CS430_UPLOAD_CHUNK_BYTES, and bands keep going until the
+// frame's time is spent, so a large image fills in over several frames
+// instead of stalling one. Time is measured on the CPU around each band, so
+// it covers mip building and the copy into the driver but not any transfer
+// the driver defers.
+typedef struct uploadBudget {
+    // Seconds each frame may spend
+    double limit;
+    // Spent so far this frame
+    double spent;
+    size_t bytes;
+    size_t bands;
+} uploadBudget;
+
+void uploadBudgetInit(uploadBudget* budget, double milliseconds);
+// Starts a new frame's allowance.
+void uploadBudgetReset(uploadBudget* budget);
+// Whether another band may be uploaded this frame. The first band always may,
+// so uploads make progress however small the budget. A NULL budget never
+// runs out.
+int uploadBudgetAvailable(const uploadBudget* budget);
+// Records a band of bytes whose upload started at clockSeconds() == start.
+void uploadBudgetCharge(uploadBudget* budget, double start, size_t bytes);
+// Rows of the given width that make up one band, at least 1.
+size_t uploadBandRows(size_t width);
+
+#endif // CS430_UPLOAD_H
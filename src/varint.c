@@ -0,0 +1,31 @@
+#include "varint.h"
+
+int writeVarint(unsigned long long value, FILE* fd) {
+    // Seven bits per byte, low bits first, high bit set on all but the last
+    do {
+        int byte = value & 0x7f;
+
+        value >>= 7;
+        if(fputc(value != 0 ? byte | 0x80 : byte, fd) == EOF) {
+            return -1;
+        }
+    } while(value != 0);
+
+    return 0;
+}
+
+int readVarint(unsigned long long* value, FILE* fd) {
+    int byte, shift = 0;
+
+    *value = 0;
+    do {
+        if((byte = fgetc(fd)) == EOF || shift > 63) {
+            return -1;
+        }
+
+        *value |= (unsigned long long)(byte & 0x7f) << shift;
+        shift += 7;
+    } while(byte & 0x80);
+
+    return 0;
+}
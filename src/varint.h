@@ -0,0 +1,10 @@
+#ifndef CS430_VARINT_H
+#define CS430_VARINT_H
+
+#include <stdio.h>
+
+// LEB128-style variable length integers for the sidecar and container files.
+int writeVarint(unsigned long long value, FILE* fd);
+int readVarint(unsigned long long* value, FILE* fd);
+
+#endif // CS430_VARINT_H
@@ -0,0 +1,99 @@
+#include <string.h>
+
+#include "view.h"
+
+imageView viewMake(pixel* pixels, size_t width, size_t height, size_t stride) {
+    imageView view;
+
+    view.pixels = pixels;
+    view.width = width;
+    view.height = height;
+    view.stride = stride;
+
+    return view;
+}
+
+pixel* viewRow(const imageView* view, size_t y) {
+    return view->pixels + y * view->stride;
+}
+
+int viewCrop(const imageView* view, size_t x, size_t y, size_t width, size_t height,
+        imageView* out) {
+    if(x > view->width || width > view->width - x ||
+            y > view->height || height > view->height - y) {
+        return -1;
+    }
+
+    *out = viewMake(view->pixels + y * view->stride + x, width, height,
+        view->stride);
+
+    return 0;
+}
+
+void viewTileCount(const imageView* view, size_t tileWidth, size_t tileHeight,
+        size_t* columns, size_t* rows) {
+    *columns = (view->width + tileWidth - 1) / tileWidth;
+    *rows = (view->height + tileHeight - 1) / tileHeight;
+}
+
+int viewTile(const imageView* view, size_t tileWidth, size_t tileHeight,
+        size_t column, size_t row, imageView* out) {
+    size_t x = column * tileWidth;
+    size_t y = row * tileHeight;
+
+    if(x >= view->width || y >= view->height) {
+        return -1;
+    }
+
+    return viewCrop(view, x, y,
+        view->width - x < tileWidth ? view->width - x : tileWidth,
+        view->height - y < tileHeight ? view->height - y : tileHeight, out);
+}
+
+int viewCopy(const imageView* dst, const imageView* src) {
+    if(dst->width != src->width || dst->height != src->height) {
+        return -1;
+    }
+
+    for(size_t i = 0; i < src->height; i++) {
+        // memmove, since the two views may be crops of the same image
+        memmove(viewRow(dst, i), viewRow(src, i), sizeof(pixel) * src->width);
+    }
+
+    return 0;
+}
+
+void viewStatistics(const imageView* view, viewStats* stats) {
+    unsigned long long sums[3] = { 0, 0, 0 };
+    size_t count = view->width * view->height;
+
+    for(int c = 0; c < 3; c++) {
+        stats->min[c] = 255;
+        stats->max[c] = 0;
+        stats->mean[c] = 0;
+    }
+
+    for(size_t i = 0; i < view->height; i++) {
+        const pixel* row = viewRow(view, i);
+
+        for(size_t j = 0; j < view->width; j++) {
+            unsigned char channels[3];
+
+            channels[0] = row[j].red;
+            channels[1] = row[j].green;
+            channels[2] = row[j].blue;
+
+            for(int c = 0; c < 3; c++) {
+                sums[c] += channels[c];
+                stats->min[c] = channels[c] < stats->min[c] ? channels[c] : stats->min[c];
+                stats->max[c] = channels[c] > stats->max[c] ? channels[c] : stats->max[c];
+            }
+        }
+    }
+
+    if(count > 0) {
+        for(int c = 0; c < 3; c++) {
+            stats->mean[c] = (double)sums[c] / count;
+        }
+    }
+}
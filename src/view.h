@@ -0,0 +1,31 @@
+#ifndef CS430_VIEW_H
+#define CS430_VIEW_H
+
+#include <stddef.h>
+
+#include "pnm.h"
+
+typedef struct viewStats {
+    unsigned char min[3];
+    unsigned char max[3];
+    double mean[3];
+} viewStats;
+
+imageView viewMake(pixel* pixels, size_t width, size_t height, size_t stride);
+pixel* viewRow(const imageView* view, size_t y);
+// Narrows a view to a rectangle without copying. Fails if the rectangle does
+// not lie entirely within the view.
+int viewCrop(const imageView* view, size_t x, size_t y, size_t width, size_t height,
+    imageView* out);
+// Splits a view into a grid of tileWidth x tileHeight tiles; tiles along the
+// right and bottom edges are clipped to the view.
+void viewTileCount(const imageView* view, size_t tileWidth, size_t tileHeight,
+    size_t* columns, size_t* rows);
+int viewTile(const imageView* view, size_t tileWidth, size_t tileHeight,
+    size_t column, size_t row, imageView* out);
+// Copies pixels between two views of the same size, row by row.
+int viewCopy(const imageView* dst, const imageView* src);
+// Per-channel min, max and mean over the view (red, green, blue order).
+void viewStatistics(const imageView* view, viewStats* stats);
+
+#endif // CS430_VIEW_H
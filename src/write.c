@@ -0,0 +1,52 @@
+#include "write.h"
+
+int writeView(const imageView* view, FILE* outputFd) {
+    if(fprintf(outputFd, "P6\n%zu %zu\n%d\n", view->width, view->height,
+            CS430_PNM_BYTE_MAX) < 0) {
+        return -1;
+    }
+
+    for(size_t i = 0; i < view->height; i++) {
+        const pixel* row = view->pixels + i * view->stride;
+
+        // The struct is exactly the P6 triplet whenever it has no padding
+        if(sizeof(pixel) == 3) {
+            if(fwrite(row, sizeof(*row), view->width, outputFd) != view->width) {
+                return -1;
+            }
+            continue;
+        }
+
+        for(size_t j = 0; j < view->width; j++) {
+            unsigned char triplet[3];
+
+            triplet[0] = row[j].red;
+            triplet[1] = row[j].green;
+            triplet[2] = row[j].blue;
+
+            if(fwrite(triplet, 1, sizeof(triplet), outputFd) != sizeof(triplet)) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int writeViewFile(const imageView* view, const char* path) {
+    FILE* outputFd;
+    int status;
+
+    // Binary mode so that the raw body is not mangled by newline translation
+    if((outputFd = fopen(path, "wb")) == NULL) {
+        return -1;
+    }
+
+    status = writeView(view, outputFd);
+
+    if(fclose(outputFd) == EOF) {
+        return -1;
+    }
+
+    return status;
+}
@@ -0,0 +1,12 @@
+#ifndef CS430_PNM_WRITE_H
+#define CS430_PNM_WRITE_H
+
+#include <stdio.h>
+
+#include "pnm.h"
+
+// Writes the view as a P6 file. Returns -1 with errno set on a write error.
+int writeView(const imageView* view, FILE* outputFd);
+int writeViewFile(const imageView* view, const char* path);
+
+#endif // CS430_PNM_WRITE_H